@@ -2,90 +2,298 @@
 #define TRANSDUCTION_H
 
 #include <list>
+#include <algorithm>
+#include <chrono>
+#include <atomic>
 
 #include <aig.hpp>
 #include <NextBdd.h>
 
+#include "TransductionConfig.h"
+#include "TransductionTrace.h"
+#include "TransductionPerf.h"
+
 using namespace NextBdd;
 
-enum class PfState {none, cspf, mspf};
+// Highest verbosity level compiled in. Messages above this level are removed
+// at compile time, e.g. -DTRANSDUCTION_VERBOSE=0 drops all of them.
+#ifndef TRANSDUCTION_VERBOSE
+#define TRANSDUCTION_VERBOSE 7
+#endif
 
-class ManUtil {
-protected:
-  Man *man;
-  inline void IncRef(lit x) const {
-    if(x != LitMax())
-      man->IncRef(x);
+enum class PfState {none, cspf, mspf, sim};
+
+// Reference count updates made through LitRef and LitVec, which are all of
+// those made by this library. Counted only when compiled with
+// TRANSDUCTION_COUNT_REFS.
+#ifdef TRANSDUCTION_COUNT_REFS
+struct TransductionRefCounts {
+  static std::atomic<long long> nIncRefs;
+  static std::atomic<long long> nDecRefs;
+};
+#define TRANSDUCTION_COUNT_REF(counter) TransductionRefCounts::counter.fetch_add(1, std::memory_order_relaxed)
+#else
+#define TRANSDUCTION_COUNT_REF(counter)
+#endif
+
+// Owning handle of a BDD literal. It is move-only, so ownership passes
+// between handles and containers without touching the reference count.
+class LitRef {
+public:
+  LitRef(): man(NULL), x(LitMax()) {}
+  LitRef(Man *man, lit x): man(man), x(x) {
+    IncRef(x);
   }
-  inline void DecRef(lit x) const {
-    if(x != LitMax())
-      man->DecRef(x);
+  LitRef(LitRef &&r): man(r.man), x(r.x) {
+    r.x = LitMax();
+  }
+  LitRef(LitRef const &) = delete;
+  ~LitRef() {
+    DecRef(x);
+  }
+  LitRef &operator=(LitRef &&r) {
+    if(this != &r) {
+      DecRef(x);
+      man = r.man;
+      x = r.x;
+      r.x = LitMax();
+    }
+    return *this;
   }
-  inline void Update(lit &x, lit y) const {
+  LitRef &operator=(LitRef const &) = delete;
+  LitRef &operator=(lit y) {
+    IncRef(y);
     DecRef(x);
     x = y;
+    return *this;
+  }
+  inline operator lit() const {
+    return x;
+  }
+  inline lit Release() {
+    lit y = x;
+    x = LitMax();
+    return y;
+  }
+
+private:
+  Man *man;
+  lit x;
+  inline void IncRef(lit y) const {
+    if(y != LitMax()) {
+      TRANSDUCTION_COUNT_REF(nIncRefs);
+      man->IncRef(y);
+    }
+  }
+  inline void DecRef(lit y) const {
+    if(y != LitMax()) {
+      TRANSDUCTION_COUNT_REF(nDecRefs);
+      man->DecRef(y);
+    }
+  }
+  friend class LitVec;
+};
+
+// Vector owning a reference to each of its literals. Elements are read
+// as plain literals and written through Set, and moving, permuting or
+// copying onto a similar vector only touches the entries that change.
+class LitVec {
+public:
+  typedef std::vector<lit>::const_iterator const_iterator;
+
+  LitVec(): man(NULL) {}
+  explicit LitVec(Man *man, unsigned n = 0): man(man), v(n, LitMax()) {}
+  LitVec(LitVec &&u): man(u.man) {
+    v.swap(u.v);
+  }
+  LitVec(LitVec const &) = delete;
+  ~LitVec() {
+    clear();
+  }
+  LitVec &operator=(LitVec &&u) {
+    if(this != &u) {
+      clear();
+      man = u.man;
+      v.swap(u.v);
+    }
+    return *this;
+  }
+  LitVec &operator=(LitVec const &) = delete;
+
+  inline unsigned size() const {
+    return v.size();
+  }
+  inline bool empty() const {
+    return v.empty();
+  }
+  inline lit operator[](unsigned i) const {
+    return v[i];
+  }
+  inline lit back() const {
+    return v.back();
+  }
+  inline const_iterator begin() const {
+    return v.begin();
+  }
+  inline const_iterator end() const {
+    return v.end();
+  }
+  inline bool operator==(LitVec const &u) const {
+    return v == u.v;
+  }
+  inline void Set(unsigned i, lit x) {
+    if(v[i] == x)
+      return;
     IncRef(x);
+    DecRef(v[i]);
+    v[i] = x;
   }
-  inline void DelVec(std::vector<lit> &v) const {
-    for(unsigned i = 0; i < v.size(); i++)
+  inline void Set(unsigned i, LitRef &&r) {
+    if(v[i] == r)
+      return;
+    DecRef(v[i]);
+    v[i] = r.Release();
+  }
+  inline LitRef Release(unsigned i) {
+    LitRef r;
+    r.man = man;
+    r.x = v[i];
+    v[i] = LitMax();
+    return r;
+  }
+  inline void push_back(lit x) {
+    IncRef(x);
+    v.push_back(x);
+  }
+  inline void insert(unsigned i, lit x) {
+    IncRef(x);
+    v.insert(v.begin() + i, x);
+  }
+  inline void erase(unsigned i) {
+    DecRef(v[i]);
+    v.erase(v.begin() + i);
+  }
+  // Move the element at position i to position j, shifting the ones
+  // in between.
+  inline void Move(unsigned i, unsigned j) {
+    if(i < j)
+      std::rotate(v.begin() + i, v.begin() + i + 1, v.begin() + j + 1);
+    else if(j < i)
+      std::rotate(v.begin() + j, v.begin() + i, v.begin() + i + 1);
+  }
+  inline void resize(unsigned n) {
+    for(unsigned i = n; i < v.size(); i++)
       DecRef(v[i]);
-    v.clear();
+    v.resize(n, LitMax());
   }
-  inline void DelVec(std::vector<std::vector<lit> > &v) const {
-    for(unsigned i = 0; i < v.size(); i++)
-      DelVec(v[i]);
-    v.clear();
+  inline void clear() {
+    resize(0);
   }
-  inline void CopyVec(std::vector<lit> &v, std::vector<lit> const &u) const {
-    DelVec(v);
-    v = u;
+  inline void Assign(LitVec const &u) {
+    if(man != u.man) {
+      clear();
+      man = u.man;
+    }
+    resize(u.size());
     for(unsigned i = 0; i < v.size(); i++)
-      IncRef(v[i]);
+      Set(i, u[i]);
   }
-  inline void CopyVec(std::vector<std::vector<lit> > &v, std::vector<std::vector<lit> > const &u) const {
-    for(unsigned i = u.size(); i < v.size(); i++)
-      DelVec(v[i]);
-    v.resize(u.size());
-    for(unsigned i = 0; i < v.size(); i++)
-      CopyVec(v[i], u[i]);
+  static inline void Assign(std::vector<LitVec> &vv, std::vector<LitVec> const &uu) {
+    vv.resize(uu.size());
+    for(unsigned i = 0; i < vv.size(); i++)
+      vv[i].Assign(uu[i]);
   }
-  inline lit Xor(lit x, lit y) const {
-    lit f = man->And(x, man->LitNot(y));
-    man->IncRef(f);
-    lit g = man->And(man->LitNot(x), y);
-    man->IncRef(g);
-    lit r = man->Or(f, g);
-    man->DecRef(f);
-    man->DecRef(g);
-    return r;
+  // Entry i moves to vMap[i], or is released if vMap[i] is -1.
+  inline void Remap(std::vector<int> const &vMap, unsigned n) {
+    std::vector<lit> v2(n, LitMax());
+    for(unsigned i = 0; i < v.size(); i++) {
+      if(vMap[i] != -1)
+        v2[vMap[i]] = v[i];
+      else
+        DecRef(v[i]);
+    }
+    v.swap(v2);
   }
-};
 
-class TransductionBackup: ManUtil {
-public:
-  ~TransductionBackup() {
-    if(man) {
-      DelVec(vFs);
-      DelVec(vGs);
-      DelVec(vvCs);
+private:
+  Man *man;
+  std::vector<lit> v;
+  inline void IncRef(lit x) const {
+    if(x != LitMax()) {
+      TRANSDUCTION_COUNT_REF(nIncRefs);
+      man->IncRef(x);
+    }
+  }
+  inline void DecRef(lit x) const {
+    if(x != LitMax()) {
+      TRANSDUCTION_COUNT_REF(nDecRefs);
+      man->DecRef(x);
     }
   }
+};
 
+class ManUtil {
+protected:
+  // Pairs found disjoint, valid for the query of generation nGen. Queries
+  // only read the manager, so threads may run them with their own memo.
+  struct DisjointMemo {
+    unsigned nGen = 0;
+    std::vector<std::pair<unsigned long long, unsigned> > vEntries;
+  };
+  Man *man;
+  mutable DisjointMemo disjoints;
+  mutable unsigned nMarkGen = 0;
+  mutable std::vector<unsigned> vMarks;
+  mutable std::vector<lit> vMarkStack;
+  bool IsDisjointRec(lit x, lit y, DisjointMemo &memo) const;
+  bool IsDisjoint(lit x, lit y, DisjointMemo &memo) const;
+  int  Measure(lit x, std::vector<unsigned long long> &vSupp) const;
+  lit  AndAll(std::vector<lit> const &vLits) const;
+  inline bool IsDisjoint(lit x, lit y) const {
+    return IsDisjoint(x, y, disjoints);
+  }
+  inline bool Implies(lit x, lit y, DisjointMemo &memo) const {
+    return IsDisjoint(x, man->LitNot(y), memo);
+  }
+  inline bool Implies(lit x, lit y) const {
+    return IsDisjoint(x, man->LitNot(y), disjoints);
+  }
+  inline lit Xor(lit x, lit y) const {
+    LitRef f(man, man->And(x, man->LitNot(y)));
+    LitRef g(man, man->And(man->LitNot(x), y));
+    return man->Or(f, g);
+  }
+};
+
+class TransductionBackup: ManUtil {
 private:
   int nObjsAlloc;
   PfState state;
   std::list<int> vObjs;
   std::vector<std::vector<int> > vvFis;
   std::vector<std::vector<int> > vvFos;
+  std::vector<std::vector<unsigned> > vvFiIdxs;
+  std::vector<std::vector<unsigned> > vvFoIdxs;
   std::vector<int> vLevels;
   std::vector<int> vSlacks;
   std::vector<std::vector<int> > vvFiSlacks;
-  std::vector<lit> vFs;
-  std::vector<lit> vGs;
-  std::vector<std::vector<lit> > vvCs;
+  LitVec vFs;
+  LitVec vGs;
+  std::vector<LitVec> vvCs;
   std::vector<bool> vUpdates;
   std::vector<bool> vPfUpdates;
   std::vector<bool> vFoConeShared;
+  std::vector<long long> vModEpochs;
+  std::vector<long long> vGEpochs;
+  std::vector<int> vPos;
+  std::vector<bool> vFrozen;
+  std::vector<bool> vIsPo;
+  std::vector<int> vFrees;
+  int nWires;
+  int nLevels;
+  std::vector<int> vLevelCounts;
+  int nIdSpace;
+  std::vector<double> vHists;
   friend class Transduction;
 };
 
@@ -96,8 +304,12 @@ public:
   int  CountNodes() const;
   int  CountLevels() const;
   void GenerateAig(aigman &aig) const;
+  std::vector<std::pair<std::string, double> > const &StartupTimes() const;
 
   Transduction(aigman const &aig, int nVerbose, int nSortType = 0, int nPiShuffle = 0, bool fLevel = false);
+  Transduction(aigman const &aig, aigman const &aigOld, aigman const &aigOpt, int nVerbose, int nSortType = 0, int nPiShuffle = 0, bool fLevel = false);
+  Transduction(aigman const &aig, TransductionConfig const &config, int nVerbose);
+  Transduction(std::string const &filename, int nVerbose);
   ~Transduction();
   bool BuildDebug();
 
@@ -106,6 +318,8 @@ public:
 
   int  Mspf(bool fSort = false, int block = -1, int block_i0 = -1);
   bool MspfDebug();
+  bool MspfSkipDebug();
+  void SetMspfWindow(int nWindow);
 
   int TrivialMerge();
   int TrivialDecompose();
@@ -114,80 +328,195 @@ public:
   int Resub(bool fMspf);
   int ResubMono(bool fMspf);
   int ResubShared(bool fMspf);
+  int ResubSim(int nWords = 4, long long nConfLimit = 10000);
+  void SetSchedule(bool fPrioritize, double nMinYield = 0);
+  void SetResubThreads(int nThreads);
 
   int RepeatResub(bool fMono, bool fMspf);
   int RepeatResubInner(bool fMspf, bool fInner);
   int RepeatResubOuter(bool fMspf, bool fInner, bool fOuter);
   int Optimize(bool fFirstMerge, bool fMspfMerge, bool fMspfResub, bool fInner, bool fOuter);
+  int Optimize(TransductionConfig const &config);
+  int RunFlow(std::string const &flow);
+  std::string const &FlowTrace() const;
+
+  void SetCheckpoint(std::string const &filename);
+  void WriteCheckpoint(std::string const &filename) const;
 
 private:
+  typedef unsigned long long word;
+
   int  nVerbose;
   int  nSortType;
   bool fLevel;
+  int  nGbc;
+  int  nReo;
+  int  nVarOrder;
   int  nObjsAlloc;
   int  nMaxLevels;
+  int  nMspfWindow;
   PfState state;
   std::vector<int> vPis;
   std::vector<int> vPos;
   std::list<int> vObjs;
   std::vector<std::vector<int> > vvFis;
   std::vector<std::vector<int> > vvFos;
+  std::vector<std::vector<unsigned> > vvFiIdxs;
+  std::vector<std::vector<unsigned> > vvFoIdxs;
   std::vector<int> vLevels;
   std::vector<int> vSlacks;
   std::vector<std::vector<int> > vvFiSlacks;
-  std::vector<lit> vFs;
-  std::vector<lit> vGs;
-  std::vector<std::vector<lit> > vvCs;
+  LitVec vFs;
+  LitVec vGs;
+  std::vector<LitVec> vvCs;
   std::vector<bool> vUpdates;
   std::vector<bool> vPfUpdates;
   std::vector<bool> vFoConeShared;
-  std::vector<lit> vPoFs;
+  long long nEpoch;
+  std::vector<long long> vModEpochs;
+  std::vector<long long> vGEpochs;
+  std::vector<long long> vConeEpochs;
+  std::vector<bool> vFrozen;
+  std::vector<bool> vIsPo;
+  std::vector<int> vFrees;
+  int nWires;
+  int nLevels;
+  std::vector<int> vLevelCounts;
+  LitVec vPoFs;
+  int nSimWords;
+  int nSimCexs;
+  std::vector<word> vSimPats;
+  std::vector<int> vRanks;
+  LitVec vCostFs;
+  std::vector<double> vCosts;
+  bool fPrioritize;
+  double nMinYield;
+  int nYieldTargets;
+  double yieldGain;
+  double yieldSecs;
+  std::chrono::steady_clock::time_point yieldTime;
+  std::vector<int> vVarPis;
+  std::chrono::steady_clock::time_point lapTime;
+  std::vector<std::pair<std::string, double> > vStartupSecs;
+  std::vector<double> vHists;
+  int nIdSpace;
+  int nIdSpaces;
+  int nResubThreads;
+  std::string flowTrace;
+  std::string checkpoint;
+  aigman aigFixed;
+
+  unsigned nTravIds;
+  std::vector<unsigned> vTravIds;
+  unsigned nVisits;
+  std::vector<unsigned> vVisits;
+  std::vector<int> vStack;
+  std::vector<std::pair<std::list<int>::iterator, unsigned> > vSortStack;
 
-  void SortObjs_rec(std::list<int>::iterator const &it);
+  void SortObjs(std::list<int>::iterator const &it);
   void Connect(int i, int f, bool fSort = false, bool fUpdate = true, lit c = LitMax());
   void Disconnect(int i, int i0, unsigned j, bool fUpdate = true, bool fPfUpdate = true);
   int  Remove(int i, bool fPfUpdate = true);
-  int  FindFi(int i, int i0) const;
+  void UpdateCounts(int i, int f, int d);
+  void AddFo(int i, unsigned l);
+  void RemoveFo(int i, unsigned l);
+  void EraseFi(int i, unsigned l);
+  void IndexFis(int i, unsigned l);
   int  Replace(int i, int f, bool fUpdate = true);
   int  ReplaceByConst(int i, bool c);
-  void NewGate(int &pos);
-  void MarkFiCone_rec(std::vector<bool> &vMarks, int i) const;
-  void MarkFoCone_rec(std::vector<bool> &vMarks, int i) const;
-  bool IsFoConeShared_rec(std::vector<int> &vVisits, int i, int visitor) const;
-  bool IsFoConeShared(int i) const;
+  int  NewGate();
+  void Allocate();
+  void Recycle(bool fCompact = false);
+  void Compact();
+  void NewTravId();
+  void MarkFiCone(int i);
+  void MarkFoCone(int i);
+  bool IsFoConeShared(int i);
   void ImportAig(aigman const &aig);
+  void Init(aigman const &aig, int nPiShuffle);
+  void NewMan(int nPis);
+  void Setup();
   void ComputeLevel();
+  void Lap(std::string const &phase);
 
+  void ComputeVarOrder(std::vector<int> &vOrder) const;
   void ShufflePis(int seed);
-  void Build(int i, std::vector<lit> &vFs_) const;
+  void Build(int i, LitVec &vFs_) const;
   void Build(bool fPfUpdate = true);
   void RemoveConstOutputs();
-  bool CostCompare(int a, int b) const;
+  void RankObjs();
+  double OneCount(int i, bool c);
+  bool CostCompare(int a, int b);
+
+  void ResetPatterns(int nWords);
+  void AddPattern(std::vector<int> const &vValues);
+  void SimulateGate(int i, std::vector<word> &vSims) const;
+  void Simulate(std::vector<word> &vSims) const;
+  void SimulateCare(int i, std::vector<word> const &vSims, std::vector<word> &vSims2, std::vector<word> &vCare) const;
+  void SimulateRedundant(int i, int f, std::vector<word> const &vSims, std::vector<word> const &vCare, std::vector<unsigned> &vRedundants) const;
+  int  CheckChange(int i, TransductionBackup const &b, std::vector<int> &vValues, long long nConfLimit) const;
   bool SortFis(int i);
 
   int  RemoveRedundantFis(int i, int block_i0 = -1, unsigned j = 0);
   void CalcG(int i);
   int  CalcC(int i);
 
-  void BuildFoConeCompl(int i, std::vector<lit> &vPoFsCompl) const;
+  void BuildFoConeCompl(int i, LitVec &vPoFsCompl, std::vector<int> &vReachedPos, LitVec &vBoundDiffs) const;
   bool MspfCalcG(int i);
   int  MspfCalcC(int i, int block_i0 = -1);
 
   int  TrivialMergeOne(int i);
-  int  TrivialDecomposeOne(std::list<int>::iterator const &it, int &pos);
-  int  BalancedDecomposeOne(std::list<int>::iterator const &it, int &pos);
+  int  TrivialDecomposeOne(std::list<int>::iterator const &it);
+  int  BalancedDecomposeOne(std::list<int>::iterator const &it);
 
   bool TryConnect(int i, int i0, bool c0);
+  void ScreenCands(int i, std::vector<int> const &vCands, unsigned begin, std::vector<char> &vPass);
+  double TargetGain(int i);
+  void ScheduleTargets(std::vector<int> &vTargets);
+  bool Progress(int i, int gain);
+
+  template <bool fLevel_, bool fMspf_>
+  int  ResubT();
+  template <bool fLevel_, bool fMspf_>
+  int  ResubMonoT();
+  template <bool fMspf_>
+  int  ResubSharedT();
+  template <bool fMono, bool fLevel_, bool fMspf_>
+  int  RepeatResubT();
+  int  RunPass(char c);
+  int  RunFlowSeq(std::string const &flow, size_t &pos, int depth);
+  int  RunFlowGroup(std::string const &passes);
+
+  void ReadCheckpoint(std::istream &is);
 
+  static void MergeEco(aigman const &aig, aigman const &aigOld, aigman const &aigOpt, aigman &aigEco, std::vector<bool> &vChanged);
+  static void SplitEco(aigman const &aigEco, std::vector<bool> const &vChanged, aigman &aigFixed, aigman &aigRegion, std::vector<bool> &vChangedRegion);
+  void SetFixedLevels();
+  void Freeze(std::vector<bool> const &vChanged);
+
+  inline int FindFi(int i0, unsigned j) const {
+    return vvFiIdxs[i0][j];
+  }
+  inline void Touch(int i) {
+    vModEpochs[i] = ++nEpoch;
+  }
+  inline bool IsTravIdCurrent(int i) const {
+    return vTravIds[i] == nTravIds;
+  }
+  inline bool Verbose(int n) const {
+    return TRANSDUCTION_VERBOSE >= n && nVerbose >= n;
+  }
   inline lit LitFi(int i, int j) const {
     int i0 = vvFis[i][j] >> 1;
     bool c0 = vvFis[i][j] & 1;
     return man->LitNotCond(vFs[i0], c0);
   }
-  inline lit LitFi(int i, int j, std::vector<lit> const &vFs_) const {
+  // Unset entries of vFs_ fall back to vFs, so that vFs_ can hold only
+  // the functions that differ.
+  inline lit LitFi(int i, int j, LitVec const &vFs_) const {
     int i0 = vvFis[i][j] >> 1;
     bool c0 = vvFis[i][j] & 1;
-    return man->LitNotCond(vFs_[i0], c0);
+    return man->LitNotCond(vFs_[i0] != LitMax()? vFs_[i0]: vFs[i0], c0);
   }
   inline bool AllFalse(std::vector<bool> const &v) const {
     for(std::list<int>::const_iterator it = vObjs.begin(); it != vObjs.end(); it++)
@@ -196,37 +525,70 @@ private:
     return true;
   }
   inline void Save(TransductionBackup &b) const {
+    TRANSDUCTION_TRACE_SCOPE("Save");
+    TRANSDUCTION_PERF_SCOPE("Save");
     b.man = man;
     b.nObjsAlloc = nObjsAlloc;
     b.state = state;
     b.vObjs = vObjs;
     b.vvFis = vvFis;
     b.vvFos = vvFos;
+    b.vvFiIdxs = vvFiIdxs;
+    b.vvFoIdxs = vvFoIdxs;
     b.vLevels = vLevels;
     b.vSlacks = vSlacks;
     b.vvFiSlacks = vvFiSlacks;
-    CopyVec(b.vFs, vFs);
-    CopyVec(b.vGs, vGs);
-    CopyVec(b.vvCs, vvCs);
+    b.vFs.Assign(vFs);
+    b.vGs.Assign(vGs);
+    LitVec::Assign(b.vvCs, vvCs);
     b.vUpdates = vUpdates;
     b.vPfUpdates = vPfUpdates;
     b.vFoConeShared = vFoConeShared;
+    b.vModEpochs = vModEpochs;
+    b.vGEpochs = vGEpochs;
+    b.vPos = vPos;
+    b.vFrozen = vFrozen;
+    b.vIsPo = vIsPo;
+    b.vFrees = vFrees;
+    b.nWires = nWires;
+    b.nLevels = nLevels;
+    b.vLevelCounts = vLevelCounts;
+    b.nIdSpace = nIdSpace;
+    b.vHists = vHists;
   }
   inline void Load(TransductionBackup const &b) {
+    TRANSDUCTION_TRACE_SCOPE("Load");
+    TRANSDUCTION_PERF_SCOPE("Load");
     nObjsAlloc = b.nObjsAlloc;
     state = b.state;
     vObjs = b.vObjs;
     vvFis = b.vvFis;
     vvFos = b.vvFos;
+    vvFiIdxs = b.vvFiIdxs;
+    vvFoIdxs = b.vvFoIdxs;
     vLevels = b.vLevels;
     vSlacks = b.vSlacks;
     vvFiSlacks = b.vvFiSlacks;
-    CopyVec(vFs, b.vFs);
-    CopyVec(vGs, b.vGs);
-    CopyVec(vvCs, b.vvCs);
+    vFs.Assign(b.vFs);
+    vGs.Assign(b.vGs);
+    LitVec::Assign(vvCs, b.vvCs);
     vUpdates = b.vUpdates;
     vPfUpdates = b.vPfUpdates;
     vFoConeShared = b.vFoConeShared;
+    vModEpochs = b.vModEpochs;
+    vGEpochs = b.vGEpochs;
+    vPos = b.vPos;
+    vFrozen = b.vFrozen;
+    vIsPo = b.vIsPo;
+    vFrees = b.vFrees;
+    nWires = b.nWires;
+    nLevels = b.nLevels;
+    vLevelCounts = b.vLevelCounts;
+    // Histories are kept across a rollback unless the ids have changed.
+    if(nIdSpace != b.nIdSpace)
+      vHists = b.vHists;
+    nIdSpace = b.nIdSpace;
+    Allocate();
   }
   inline void add(std::vector<bool> &a, unsigned i) {
     if(a.size() <= i) {
@@ -275,10 +637,10 @@ public:
   }
   inline bool Verify() const {
     for(unsigned j = 0; j < vPos.size(); j++) {
-      lit x = Xor(LitFi(vPos[j], 0), vPoFs[j]);
-      IncRef(x);
-      Update(x, man->And(x, man->LitNot(vvCs[vPos[j]][0])));
-      DecRef(x);
+      if(LitFi(vPos[j], 0) == vPoFs[j])
+        continue;
+      LitRef x(man, Xor(LitFi(vPos[j], 0), vPoFs[j]));
+      x = man->And(x, man->LitNot(vvCs[vPos[j]][0]));
       if(!man->IsConst0(x))
         return false;
     }
@@ -0,0 +1,48 @@
+#ifndef TRANSDUCTION_CACHE_H
+#define TRANSDUCTION_CACHE_H
+
+#include <string>
+#include <vector>
+#include <map>
+
+#include <aig.hpp>
+
+// On-disk cache of optimized AIGs.
+// An entry is keyed by a canonical structural hash of the input AIG
+// combined with the optimization parameters, and stores the result as
+// "<dir>/<key>.aig". The index "<dir>/index" keeps size, checksum and
+// last use of each entry for integrity checking and LRU eviction.
+class TransductionCache {
+public:
+  TransductionCache(std::string const &dir, long long nMaxBytes = 1ll << 30, int nMaxEntries = 100000, int nVerbose = 0);
+
+  static std::string Hash(aigman const &aig);
+  static std::string Key(aigman const &aig, int nSortType, int nPiShuffle, bool fLevel, bool fFirstMerge, bool fMspfMerge, bool fMspfResub, bool fInner, bool fOuter);
+
+  bool Lookup(std::string const &key, aigman &aig);
+  void Insert(std::string const &key, aigman &aig);
+
+private:
+  struct Entry {
+    long long nBytes;
+    unsigned long long checksum;
+    long long tick;
+  };
+  std::string dir;
+  long long nMaxBytes;
+  int nMaxEntries;
+  int nVerbose;
+  long long nBytes;
+  long long tick;
+  std::map<std::string, Entry> entries;
+
+  std::string EntryPath(std::string const &key) const;
+  static std::string TempPath(std::string const &filename);
+  void ReadIndex();
+  void WriteIndex();
+  void Erase(std::string const &key);
+  void Evict();
+  static bool Checksum(std::string const &filename, long long &nBytes, unsigned long long &checksum);
+};
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef TRANSDUCTION_CEC_H
+#define TRANSDUCTION_CEC_H
+
+#include <vector>
+#include <map>
+
+#include <aig.hpp>
+
+#include "TransductionSat.h"
+
+// Combinational equivalence checking of two AIGs with the same interface.
+// Both are hashed into one miter, and random simulation looks for easy
+// mismatches. Internal nodes with equal signatures are then proved
+// equivalent in topological order, and finally the po pairs are proved one
+// by one, all with one incremental SAT solver. Check returns 1
+// (equivalent), 0 (not equivalent, with a counterexample) or -1 (undecided
+// within the time budget).
+class TransductionCec {
+public:
+  TransductionCec(aigman const &aig0, aigman const &aig1, int nVerbose = 0);
+
+  int  Check(double nSeconds = 0, int nSimWords = 16, long long nSweepConfs = 1000);
+  int  FailedPo() const;
+  std::vector<bool> const &Cex() const;
+
+private:
+  typedef unsigned long long word;
+
+  int nVerbose;
+  int nPis;
+  std::vector<int> vFanins;
+  std::map<std::pair<int, int>, int> strash;
+  std::vector<int> vPos0;
+  std::vector<int> vPos1;
+  std::vector<int> vVars;
+  int nWords;
+  std::vector<word> vSims;
+  std::vector<word> vCexSims;
+  int nCexs;
+  TransductionSat sat;
+  bool fDeadline;
+  std::chrono::steady_clock::time_point deadline;
+  int iFailedPo;
+  std::vector<bool> vCex;
+
+  int  And(int a, int b);
+  void Import(aigman const &aig, std::vector<int> &vPos);
+  void Simulate();
+  bool AddPattern();
+  bool CheckPos();
+  void Signature(int i, std::vector<word> &vSig) const;
+  void Sweep(long long nConfLimit);
+  int  Encode(int x);
+  bool TimedOut() const;
+};
+
+#endif
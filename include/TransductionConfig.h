@@ -0,0 +1,27 @@
+#ifndef TRANSDUCTION_CONFIG_H
+#define TRANSDUCTION_CONFIG_H
+
+#include <string>
+#include <iostream>
+
+// Parameters of an optimization run, stored as "<name> <value>" lines
+// with '#' starting a comment. Names not given keep their defaults.
+struct TransductionConfig {
+  int  nSortType = 0;
+  int  nPiShuffle = 0;
+  bool fLevel = false;
+  bool fFirstMerge = false;
+  bool fMspfMerge = false;
+  bool fMspfResub = false;
+  bool fInner = false;
+  bool fOuter = false;
+  int  nGbc = 1;
+  int  nReo = 4000;
+  int  nVarOrder = 0;
+
+  void Read(std::string const &filename);
+  void Read(std::istream &is);
+  void Write(std::ostream &os) const;
+};
+
+#endif
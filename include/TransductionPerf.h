@@ -0,0 +1,71 @@
+#ifndef TRANSDUCTION_PERF_H
+#define TRANSDUCTION_PERF_H
+
+#include <iostream>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+
+// Hardware counters (cycles, instructions, last level cache misses and
+// branch misses) accumulated per phase, read through Linux perf_event. The
+// counters of each thread are opened when it first enters a phase. Enable
+// returns false and profiling stays off if no counter can be opened, as in
+// most containers; counters missing on the machine are reported as "-".
+// Counts are inclusive of nested phases.
+class TransductionPerf {
+public:
+  static const int nCounters = 4;
+
+  class Site {
+  public:
+    explicit Site(char const *name);
+  private:
+    char const *name;
+    long long nCalls;
+    double seconds;
+    long long vCounts[nCounters];
+    friend class TransductionPerf;
+  };
+
+  class Scope {
+  public:
+    explicit Scope(Site &site): site(site), fActive(false) {
+      if(fEnabled.load(std::memory_order_relaxed)) {
+        fActive = true;
+        Start(vCounts, start);
+      }
+    }
+    ~Scope() {
+      if(fActive)
+        Stop(site, vCounts, start);
+    }
+    Scope(Scope const &) = delete;
+    Scope &operator=(Scope const &) = delete;
+  private:
+    Site &site;
+    bool fActive;
+    long long vCounts[nCounters];
+    std::chrono::steady_clock::time_point start;
+  };
+
+  static bool Enable();
+  static void Disable();
+  static void Report(std::ostream &os);
+
+private:
+  static std::atomic<bool> fEnabled;
+  static std::mutex mtx;
+  static std::vector<Site *> vSites;
+
+  static void Start(long long *vCounts, std::chrono::steady_clock::time_point &start);
+  static void Stop(Site &site, long long const *vCounts, std::chrono::steady_clock::time_point start);
+};
+
+#define TRANSDUCTION_PERF_CAT2(a, b) a##b
+#define TRANSDUCTION_PERF_CAT(a, b) TRANSDUCTION_PERF_CAT2(a, b)
+#define TRANSDUCTION_PERF_SCOPE(name) \
+  static TransductionPerf::Site TRANSDUCTION_PERF_CAT(perfSite, __LINE__)(name); \
+  TransductionPerf::Scope TRANSDUCTION_PERF_CAT(perfScope, __LINE__)(TRANSDUCTION_PERF_CAT(perfSite, __LINE__))
+
+#endif
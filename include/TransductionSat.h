@@ -0,0 +1,73 @@
+#ifndef TRANSDUCTION_SAT_H
+#define TRANSDUCTION_SAT_H
+
+#include <vector>
+#include <chrono>
+
+// Small CDCL solver used for equivalence checking.
+// Literals follow the AIG convention, var * 2 + complement. Solve takes
+// assumptions, so that one instance can be queried incrementally, and
+// returns 1 (satisfiable), 0 (unsatisfiable) or -1 (budget exhausted).
+class TransductionSat {
+public:
+  TransductionSat();
+
+  int  NewVar();
+  int  NumVars() const;
+  bool AddClause(std::vector<int> vLits);
+  void SetDeadline(std::chrono::steady_clock::time_point deadline);
+  int  Solve(std::vector<int> const &vAssumps, long long nConfLimit = -1);
+  bool Value(int v) const;
+
+private:
+  struct Clause {
+    std::vector<int> vLits;
+    bool fLearnt;
+    double act;
+  };
+  bool fOk;
+  bool fDeadline;
+  std::chrono::steady_clock::time_point deadline;
+  std::vector<Clause> vClauses;
+  std::vector<std::vector<int> > vvWatches;
+  std::vector<signed char> vAssigns;
+  std::vector<bool> vPhases;
+  std::vector<bool> vModel;
+  std::vector<int> vLevels;
+  std::vector<int> vReasons;
+  std::vector<double> vActs;
+  std::vector<bool> vSeen;
+  std::vector<int> vTrail;
+  std::vector<int> vTrailLims;
+  unsigned qhead;
+  std::vector<int> vHeap;
+  std::vector<int> vHeapIdxs;
+  double varInc;
+  double claInc;
+  int nLearnts;
+  int nMaxLearnts;
+
+  void Attach(int c);
+  void Enqueue(int x, int c);
+  int  Propagate();
+  void Analyze(int c, std::vector<int> &vLearnt, int &level);
+  void Cancel(int level);
+  void Reduce();
+  int  Search(std::vector<int> const &vAssumps, long long nConfs, long long &nConfsDone);
+  void BumpVar(int v);
+  void BumpClause(int c);
+  void HeapUp(int k);
+  void HeapDown(int k);
+  void HeapInsert(int v);
+  int  HeapPop();
+
+  inline int LitValue(int x) const {
+    signed char a = vAssigns[x >> 1];
+    return a < 0? -1: a ^ (x & 1);
+  }
+  inline int Level() const {
+    return vTrailLims.size();
+  }
+};
+
+#endif
@@ -0,0 +1,88 @@
+#ifndef TRANSDUCTION_TRACE_H
+#define TRANSDUCTION_TRACE_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <chrono>
+
+// Timeline of scoped events saved as a Chrome trace, which opens in
+// Perfetto or chrome://tracing. Events are recorded only while a trace is
+// open and only when compiled with TRANSDUCTION_TRACING; otherwise the
+// scope macros below expand to nothing. Of the events of each scope site,
+// the first and then every nSampleRate-th are kept, events shorter than
+// nMinMicros are dropped, and recording stops at nMaxEvents.
+class TransductionTrace {
+public:
+  class Site {
+  public:
+    explicit Site(char const *name): name(name), count(0) {}
+  private:
+    char const *name;
+    std::atomic<unsigned> count;
+    friend class TransductionTrace;
+  };
+
+  class Scope {
+  public:
+    Scope(Site &site, int arg = -1): site(site), arg(arg), fActive(false) {
+      if(fOpen.load(std::memory_order_relaxed) && site.count++ % nSampleRate == 0) {
+        fActive = true;
+        start = std::chrono::steady_clock::now();
+      }
+    }
+    ~Scope() {
+      if(fActive)
+        Record(site.name, arg, start);
+    }
+    Scope(Scope const &) = delete;
+    Scope &operator=(Scope const &) = delete;
+  private:
+    Site &site;
+    int arg;
+    bool fActive;
+    std::chrono::steady_clock::time_point start;
+  };
+
+  static void Open(std::string const &filename, unsigned nSampleRate = 1, long long nMaxEvents = 1000000, double nMinMicros = 0);
+  static void Close();
+
+private:
+  struct Event {
+    char const *name;
+    int arg;
+    int tid;
+    double ts;
+    double dur;
+  };
+
+  static std::atomic<bool> fOpen;
+  static unsigned nSampleRate;
+  static long long nMaxEvents;
+  static double nMinMicros;
+  static long long nDropped;
+  static std::string filename;
+  static std::chrono::steady_clock::time_point origin;
+  static std::mutex mtx;
+  static std::vector<Event> vEvents;
+  static std::map<std::thread::id, int> tids;
+
+  static void Record(char const *name, int arg, std::chrono::steady_clock::time_point start);
+};
+
+#define TRANSDUCTION_TRACE_CAT2(a, b) a##b
+#define TRANSDUCTION_TRACE_CAT(a, b) TRANSDUCTION_TRACE_CAT2(a, b)
+
+#ifdef TRANSDUCTION_TRACING
+#define TRANSDUCTION_TRACE_SCOPE_ARG(name, arg) \
+  static TransductionTrace::Site TRANSDUCTION_TRACE_CAT(traceSite, __LINE__)(name); \
+  TransductionTrace::Scope TRANSDUCTION_TRACE_CAT(traceScope, __LINE__)(TRANSDUCTION_TRACE_CAT(traceSite, __LINE__), arg)
+#else
+#define TRANSDUCTION_TRACE_SCOPE_ARG(name, arg)
+#endif
+#define TRANSDUCTION_TRACE_SCOPE(name) TRANSDUCTION_TRACE_SCOPE_ARG(name, -1)
+
+#endif
@@ -1,73 +1,336 @@
 #include <iostream>
 #include <algorithm>
+#include <random>
 #include <cassert>
 
 #include "Transduction.h"
 
 using namespace std;
 
-Transduction::Transduction(aigman const &aig, int nVerbose, int nSortType, int nPiShuffle, bool fLevel): nVerbose(nVerbose), nSortType(nSortType), fLevel(fLevel) {
+#ifdef TRANSDUCTION_COUNT_REFS
+atomic<long long> TransductionRefCounts::nIncRefs(0);
+atomic<long long> TransductionRefCounts::nDecRefs(0);
+#endif
+
+// Whether x & y is constant 0, found by walking both BDDs in parallel
+// without creating nodes. Pairs found disjoint are kept in a small
+// direct-mapped table for the duration of one query.
+bool ManUtil::IsDisjoint(lit x, lit y, DisjointMemo &memo) const {
+  if(memo.vEntries.empty())
+    memo.vEntries.resize(1 << 12);
+  if(++memo.nGen == 0) {
+    fill(memo.vEntries.begin(), memo.vEntries.end(), make_pair(0ull, 0u));
+    memo.nGen = 1;
+  }
+  return IsDisjointRec(x, y, memo);
+}
+bool ManUtil::IsDisjointRec(lit x, lit y, DisjointMemo &memo) const {
+  if(man->IsConst0(x) || man->IsConst0(y) || x == man->LitNot(y))
+    return true;
+  if(man->IsConst1(x) || man->IsConst1(y) || x == y)
+    return false;
+  if(x > y)
+    swap(x, y);
+  unsigned long long key = ((unsigned long long)x << 32) | y;
+  pair<unsigned long long, unsigned> &entry = memo.vEntries[(key * 0x9e3779b97f4a7c15ull) >> 52];
+  if(entry.first == key && entry.second == memo.nGen)
+    return true;
+  lit x1 = x, x0 = x, y1 = y, y0 = y;
+  if(man->Level(x) <= man->Level(y)) {
+    x1 = man->Then(x);
+    x0 = man->Else(x);
+  }
+  if(man->Level(y) <= man->Level(x)) {
+    y1 = man->Then(y);
+    y0 = man->Else(y);
+  }
+  if(!IsDisjointRec(x1, y1, memo) || !IsDisjointRec(x0, y0, memo))
+    return false;
+  entry = make_pair(key, memo.nGen);
+  return true;
+}
+
+// Number of nodes of x, with its support as a bit set of variables.
+int ManUtil::Measure(lit x, vector<unsigned long long> &vSupp) const {
+  vSupp.assign((man->GetNVars() + 63) / 64, 0);
+  if(++nMarkGen == 0) {
+    fill(vMarks.begin(), vMarks.end(), 0u);
+    nMarkGen = 1;
+  }
+  int count = 0;
+  vMarkStack.assign(1, x);
+  while(!vMarkStack.empty()) {
+    lit y = vMarkStack.back();
+    vMarkStack.pop_back();
+    if(man->IsConst0(y) || man->IsConst1(y))
+      continue;
+    unsigned n = y >> 1;
+    if(n >= vMarks.size())
+      vMarks.resize(2 * n + 1);
+    if(vMarks[n] == nMarkGen)
+      continue;
+    vMarks[n] = nMarkGen;
+    count++;
+    var v = man->Var(y);
+    vSupp[v >> 6] |= 1ull << (v & 63);
+    vMarkStack.push_back(man->Then(y));
+    vMarkStack.push_back(man->Else(y));
+  }
+  return count;
+}
+
+// Conjunction of the literals. The smallest operand is repeatedly combined
+// with the one adding the fewest variables to its support, and the
+// computation stops as soon as the product becomes constant 0.
+lit ManUtil::AndAll(vector<lit> const &vLits) const {
+  vector<lit> v;
+  for(unsigned i = 0; i < vLits.size(); i++) {
+    if(man->IsConst0(vLits[i]))
+      return man->Const0();
+    if(!man->IsConst1(vLits[i]))
+      v.push_back(vLits[i]);
+  }
+  sort(v.begin(), v.end());
+  v.erase(unique(v.begin(), v.end()), v.end());
+  for(unsigned i = 1; i < v.size(); i++)
+    if(v[i] == man->LitNot(v[i - 1]))
+      return man->Const0();
+  if(v.empty())
+    return man->Const1();
+  if(v.size() == 1)
+    return v[0];
+  if(v.size() == 2)
+    return man->And(v[0], v[1]);
+  vector<LitRef> vOps;
+  vector<int> vSizes;
+  vector<vector<unsigned long long> > vSupps(v.size());
+  for(unsigned i = 0; i < v.size(); i++) {
+    vOps.emplace_back(man, v[i]);
+    vSizes.push_back(Measure(v[i], vSupps[i]));
+  }
+  while(true) {
+    unsigned a = min_element(vSizes.begin(), vSizes.end()) - vSizes.begin();
+    unsigned b = vOps.size();
+    int bestNew = 0;
+    for(unsigned k = 0; k < vOps.size(); k++) {
+      if(k == a)
+        continue;
+      int nNew = 0;
+      for(unsigned w = 0; w < vSupps[k].size(); w++)
+        nNew += __builtin_popcountll(vSupps[k][w] & ~vSupps[a][w]);
+      if(b == vOps.size() || nNew < bestNew || (nNew == bestNew && vSizes[k] < vSizes[b])) {
+        b = k;
+        bestNew = nNew;
+      }
+    }
+    LitRef r(man, man->And(vOps[a], vOps[b]));
+    if(man->IsConst0(r))
+      return man->Const0();
+    if(vOps.size() == 2)
+      return r;
+    if(a < b)
+      swap(a, b);
+    vOps.erase(vOps.begin() + a);
+    vOps.erase(vOps.begin() + b);
+    vSizes.erase(vSizes.begin() + a);
+    vSizes.erase(vSizes.begin() + b);
+    vSupps.erase(vSupps.begin() + a);
+    vSupps.erase(vSupps.begin() + b);
+    vSupps.emplace_back();
+    vSizes.push_back(Measure(r, vSupps.back()));
+    vOps.push_back(std::move(r));
+  }
+}
+
+Transduction::Transduction(aigman const &aig, int nVerbose, int nSortType, int nPiShuffle, bool fLevel): nVerbose(nVerbose), nSortType(nSortType), fLevel(fLevel), nGbc(1), nReo(4000), nVarOrder(0) {
+  Init(aig, nPiShuffle);
+}
+Transduction::Transduction(aigman const &aig, TransductionConfig const &config, int nVerbose): nVerbose(nVerbose), nSortType(config.nSortType), fLevel(config.fLevel), nGbc(config.nGbc), nReo(config.nReo), nVarOrder(config.nVarOrder) {
+  Init(aig, config.nPiShuffle);
+}
+Transduction::Transduction(aigman const &aig, aigman const &aigOld, aigman const &aigOpt, int nVerbose, int nSortType, int nPiShuffle, bool fLevel): nVerbose(nVerbose), nSortType(nSortType), fLevel(fLevel), nGbc(1), nReo(4000), nVarOrder(0) {
+  aigman aigEco;
+  vector<bool> vChanged;
+  MergeEco(aig, aigOld, aigOpt, aigEco, vChanged);
+  aigman aigRegion;
+  vector<bool> vChangedRegion;
+  SplitEco(aigEco, vChanged, aigFixed, aigRegion, vChangedRegion);
+  Init(aigRegion, nPiShuffle);
+  Freeze(vChangedRegion);
+}
+void Transduction::Init(aigman const &aig, int nPiShuffle) {
+  nTravIds = 0;
+  nVisits = 0;
+  nWires = 0;
+  nEpoch = 0;
+  nLevels = 0;
+  nSimWords = 0;
+  nSimCexs = 0;
+  nMspfWindow = 0;
+  fPrioritize = false;
+  nMinYield = 0;
+  nResubThreads = 0;
+  nIdSpace = 0;
+  nIdSpaces = 0;
+  vStartupSecs.clear();
+  lapTime = chrono::steady_clock::now();
+  NewMan(aig.nPis);
+  ImportAig(aig);
+  Lap("ImportAig");
+  nMaxLevels = -1;
+  Setup();
+  state = PfState::none;
+  if(nPiShuffle)
+    ShufflePis(nPiShuffle);
+  if(fLevel) {
+    if(aigFixed.nPos)
+      SetFixedLevels();
+    ComputeLevel();
+    Lap("ComputeLevel");
+  }
+}
+void Transduction::NewMan(int nPis) {
   Param p;
-  p.nGbc = 1;
-  p.nReo = 4000;
+  p.nGbc = nGbc;
+  p.nReo = nReo;
   if(nSortType)
     p.fCountOnes = true;
-  man = new Man(aig.nPis, p);
-  ImportAig(aig);
-  Update(vFs[0], man->Const0());
-  for(unsigned i = 0; i < vPis.size(); i++)
-    Update(vFs[i + 1], man->IthVar(i));
-  nMaxLevels = -1;
+  man = new Man(nPis, p);
+  vFs = LitVec(man);
+  vGs = LitVec(man);
+  vvCs.clear();
+  vPoFs = LitVec(man);
+  vCostFs = LitVec(man);
+}
+// The pi at position k of the static order gets the variable at level k.
+void Transduction::Setup() {
+  vector<int> vOrder;
+  ComputeVarOrder(vOrder);
+  vVarPis.resize(vPis.size());
+  vFs.Set(0, man->Const0());
+  for(unsigned v = 0; v < vPis.size(); v++) {
+    vVarPis[v] = vOrder[man->Level(man->IthVar(v))];
+    vFs.Set(vVarPis[v] + 1, man->IthVar(v));
+  }
+  Lap("VarOrder");
   Build(false);
-  man->Reorder();
-  man->TurnOffReo();
+  Lap("Build");
+  {
+    TRANSDUCTION_TRACE_SCOPE("Reorder");
+    TRANSDUCTION_PERF_SCOPE("Reorder");
+    man->Reorder();
+    man->TurnOffReo();
+  }
+  Lap("Reorder");
   for(unsigned i = 0; i < vPos.size(); i++)
-    Update(vvCs[vPos[i]][0], man->Const0());
+    vvCs[vPos[i]].Set(0, man->Const0());
   RemoveConstOutputs();
-  vPoFs.resize(vPos.size(), LitMax());
+  Recycle();
+  Lap("RemoveConstOutputs");
+  vPoFs.resize(vPos.size());
   for(unsigned i = 0; i < vPos.size(); i++)
-    Update(vPoFs[i], LitFi(vPos[i], 0));
-  state = PfState::none;
-  if(nPiShuffle)
-    ShufflePis(nPiShuffle);
-  if(fLevel)
-    ComputeLevel();
+    vPoFs.Set(i, LitFi(vPos[i], 0));
 }
 Transduction::~Transduction() {
-  DelVec(vFs);
-  DelVec(vGs);
-  DelVec(vvCs);
-  DelVec(vPoFs);
+  vFs.clear();
+  vGs.clear();
+  vvCs.clear();
+  vPoFs.clear();
+  vCostFs.clear();
   assert(man->CountNodes() == (int)vPis.size() + 1);
   assert(!man->Ref(man->Const0()));
   delete man;
 }
 
+void Transduction::Lap(string const &phase) {
+  chrono::steady_clock::time_point now = chrono::steady_clock::now();
+  vStartupSecs.emplace_back(phase, chrono::duration<double>(now - lapTime).count());
+  lapTime = now;
+  if(Verbose(2))
+    cout << "\t" << phase << ": " << vStartupSecs.back().second << "s" << endl;
+}
+vector<pair<string, double> > const &Transduction::StartupTimes() const {
+  return vStartupSecs;
+}
+
+// Static orders of the pis, given as 0-based pi indices from the top:
+// 0 keeps pi i at variable i, 1 takes the pis as a depth-first search from
+// the pos first reaches them, and 2 sorts them by fanout weight, where
+// each po has weight 1 and each node splits its weight among its fanins.
+void Transduction::ComputeVarOrder(vector<int> &vOrder) const {
+  vOrder.clear();
+  switch(nVarOrder) {
+  case 1: {
+    vector<bool> vVisited(nObjsAlloc);
+    vector<int> vStack;
+    for(unsigned i = 0; i < vPos.size(); i++) {
+      vStack.push_back(vvFis[vPos[i]][0] >> 1);
+      while(!vStack.empty()) {
+        int k = vStack.back();
+        vStack.pop_back();
+        if(vVisited[k])
+          continue;
+        vVisited[k] = true;
+        if(k && k <= (int)vPis.size())
+          vOrder.push_back(k - 1);
+        for(int j = (int)vvFis[k].size() - 1; j >= 0; j--)
+          if(!vVisited[vvFis[k][j] >> 1])
+            vStack.push_back(vvFis[k][j] >> 1);
+      }
+    }
+    for(unsigned i = 0; i < vPis.size(); i++)
+      if(!vVisited[i + 1])
+        vOrder.push_back(i);
+    break;
+  }
+  case 2: {
+    vector<double> vWeights(nObjsAlloc);
+    for(unsigned i = 0; i < vPos.size(); i++)
+      vWeights[vvFis[vPos[i]][0] >> 1] += 1;
+    for(list<int>::const_reverse_iterator it = vObjs.rbegin(); it != vObjs.rend(); it++)
+      for(unsigned j = 0; j < vvFis[*it].size(); j++)
+        vWeights[vvFis[*it][j] >> 1] += vWeights[*it] / vvFis[*it].size();
+    for(unsigned i = 0; i < vPis.size(); i++)
+      vOrder.push_back(i);
+    stable_sort(vOrder.begin(), vOrder.end(), [&](int a, int b) { return vWeights[a + 1] > vWeights[b + 1]; });
+    break;
+  }
+  default:
+    vOrder.resize(vPis.size());
+    for(unsigned i = 0; i < vPis.size(); i++)
+      vOrder[man->Level(man->IthVar(i))] = i;
+    break;
+  }
+}
+
 void Transduction::ShufflePis(int seed) {
-  srand(seed);
+  mt19937 rng(seed);
   for(int i = (int)vPis.size() - 1; i > 0; i--)
-    swap(vPis[i], vPis[rand() % (i + 1)]);
+    swap(vPis[i], vPis[rng() % (i + 1)]);
 }
 
-void Transduction::Build(int i, vector<lit> &vFs_) const {
-  if(nVerbose > 4)
+void Transduction::Build(int i, LitVec &vFs_) const {
+  if(Verbose(5))
     cout << "\t\t\t\tBuild " << i << endl;
-  Update(vFs_[i], man->Const1());
+  vector<lit> vLits;
   for(unsigned j = 0; j < vvFis[i].size(); j++)
-    Update(vFs_[i], man->And(vFs_[i], LitFi(i, j, vFs_)));
+    vLits.push_back(LitFi(i, j, vFs_));
+  vFs_.Set(i, AndAll(vLits));
 }
 void Transduction::Build(bool fPfUpdate) {
-  if(nVerbose > 3)
+  if(Verbose(4))
     cout << "\t\t\tBuild" << endl;
+  TRANSDUCTION_TRACE_SCOPE("Build");
+  TRANSDUCTION_PERF_SCOPE("Build");
   for(list<int>::iterator it = vObjs.begin(); it != vObjs.end(); it++)
     if(vUpdates[*it]) {
-      lit x = vFs[*it];
-      IncRef(x);
+      LitRef x = vFs.Release(*it);
       Build(*it, vFs);
-      DecRef(x);
       if(x != vFs[*it])
-        for(unsigned j = 0; j < vvFos[*it].size(); j++)
+        for(unsigned j = 0; j < vvFos[*it].size(); j++) {
           vUpdates[vvFos[*it][j]] = true;
+          Touch(vvFos[*it][j]);
+        }
     }
   if(fPfUpdate)
     for(list<int>::iterator it = vObjs.begin(); it != vObjs.end(); it++)
@@ -79,12 +342,10 @@ void Transduction::Build(bool fPfUpdate) {
 bool Transduction::BuildDebug() {
   for(list<int>::iterator it = vObjs.begin(); it != vObjs.end(); it++)
     vUpdates[*it] = true;
-  vector<lit> vFsOld;
-  CopyVec(vFsOld, vFs);
+  LitVec vFsOld;
+  vFsOld.Assign(vFs);
   Build(false);
-  bool r = vFsOld == vFs;
-  DelVec(vFsOld);
-  return r;
+  return vFsOld == vFs;
 }
 
 void Transduction::RemoveConstOutputs() {
@@ -93,14 +354,14 @@ void Transduction::RemoveConstOutputs() {
     int i0 = vvFis[vPos[i]][0] >> 1;
     lit c = vvCs[vPos[i]][0];
     if(i0) {
-      if(man->IsConst1(man->Or(LitFi(vPos[i], 0), c))) {
-        if(nVerbose > 3)
+      if(Implies(man->LitNot(c), LitFi(vPos[i], 0))) {
+        if(Verbose(4))
           cout << "\t\t\tConst 1 output : po " << i << endl;
         Disconnect(vPos[i], i0, 0, false, false);
         Connect(vPos[i], 1, false, false, c);
         fRemoved |= vvFos[i0].empty();
-      } else if(man->IsConst1(man->Or(man->LitNot(LitFi(vPos[i], 0)), c))) {
-        if(nVerbose > 3)
+      } else if(IsDisjoint(man->LitNot(c), LitFi(vPos[i], 0))) {
+        if(Verbose(4))
           cout << "\t\t\tConst 0 output : po " << i << endl;
         Disconnect(vPos[i], i0, 0, false, false);
         Connect(vPos[i], 0, false, false, c);
@@ -109,7 +370,7 @@ void Transduction::RemoveConstOutputs() {
     }
   }
   if(fRemoved) {
-    if(nVerbose > 3)
+    if(Verbose(4))
       cout << "\t\t\tRemove unused" << endl;
     for(list<int>::reverse_iterator it = vObjs.rbegin(); it != vObjs.rend();) {
       if(vvFos[*it].empty()) {
@@ -122,12 +383,36 @@ void Transduction::RemoveConstOutputs() {
   }
 }
 
+// Positions of pis in vPis and of gates in vObjs, which stay valid during
+// a Cspf or Mspf pass as nodes are only removed there.
+void Transduction::RankObjs() {
+  vRanks.assign(nObjsAlloc, -1);
+  for(unsigned i = 0; i < vPis.size(); i++)
+    vRanks[vPis[i]] = i;
+  int r = 0;
+  for(list<int>::iterator it = vObjs.begin(); it != vObjs.end(); it++)
+    vRanks[*it] = r++;
+}
+
+// Minterm counts are cached per node along with the function they were
+// computed for, so a rebuilt node is recounted on demand.
+double Transduction::OneCount(int i, bool c) {
+  if(vCostFs[i] != vFs[i]) {
+    vCostFs.Set(i, vFs[i]);
+    vCosts[i + i] = vCosts[i + i + 1] = -1;
+  }
+  double &x = vCosts[i + i + c];
+  if(x < 0)
+    x = man->OneCount(man->LitNotCond(vFs[i], c));
+  return x;
+}
+
 // cost(a) > cost(b)
-bool Transduction::CostCompare(int a, int b) const {
+bool Transduction::CostCompare(int a, int b) {
   int a0 = a >> 1;
   int b0 = b >> 1;
   if(vvFis[a0].empty() && vvFis[b0].empty())
-    return find(find(vPis.begin(), vPis.end(), a0), vPis.end(), b0) != vPis.end();
+    return vRanks[a0] >= 0 && vRanks[b0] >= vRanks[a0];
   if(vvFis[a0].empty() && !vvFis[b0].empty())
     return false;
   if(!vvFis[a0].empty() && vvFis[b0].empty())
@@ -140,36 +425,39 @@ bool Transduction::CostCompare(int a, int b) const {
   bool bc = b & 1;
   switch(nSortType) {
   case 0:
-    return find(find(vObjs.begin(), vObjs.end(), a0), vObjs.end(), b0) == vObjs.end();
+    return vRanks[a0] < 0 || vRanks[b0] < 0 || vRanks[b0] < vRanks[a0];
   case 1:
-    return man->OneCount(man->LitNotCond(vFs[a0], ac)) < man->OneCount(man->LitNotCond(vFs[b0], bc));
+    return OneCount(a0, ac) < OneCount(b0, bc);
   case 2:
-    return man->OneCount(vFs[a0]) < man->OneCount(vFs[b0]);
+    return OneCount(a0, false) < OneCount(b0, false);
   case 3:
-    return man->OneCount(man->LitNot(vFs[a0])) < man->OneCount(vFs[b0]);
+    return OneCount(a0, true) < OneCount(b0, false);
   default:
     return false;
   }
 }
 bool Transduction::SortFis(int i) {
-  if(nVerbose > 4)
+  if(Verbose(5))
     cout << "\t\t\t\tSort fanins " << i << endl;
   bool fSort = false;
   for(int p = 1; p < (int)vvFis[i].size(); p++) {
     int f = vvFis[i][p];
-    lit c = vvCs[i][p];
     int q = p - 1;
+    unsigned idx = vvFoIdxs[i][p];
     for(; q >= 0 && CostCompare(f, vvFis[i][q]); q--) {
       vvFis[i][q + 1] = vvFis[i][q];
-      vvCs[i][q + 1] = vvCs[i][q];
+      vvFoIdxs[i][q + 1] = vvFoIdxs[i][q];
     }
     if(q + 1 != p) {
       fSort = true;
       vvFis[i][q + 1] = f;
-      vvCs[i][q + 1] = c;
+      vvCs[i].Move(p, q + 1);
+      vvFoIdxs[i][q + 1] = idx;
     }
   }
-  if(nVerbose > 5)
+  if(fSort)
+    IndexFis(i, 0);
+  if(Verbose(6))
     for(unsigned j = 0; j < vvFis[i].size(); j++)
       cout << "\t\t\t\t\tFanin " << j << " : " << (vvFis[i][j] >> 1) << "(" << (vvFis[i][j] & 1) << ")" << endl;
   return fSort;
@@ -0,0 +1,196 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <cstdio>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "TransductionCache.h"
+
+using namespace std;
+
+static inline unsigned long long Mix(unsigned long long x) {
+  x ^= x >> 30;
+  x *= 0xbf58476d1ce4e5b9ull;
+  x ^= x >> 27;
+  x *= 0x94d049bb133111ebull;
+  x ^= x >> 31;
+  return x;
+}
+static inline unsigned long long Combine(unsigned long long h, unsigned long long x) {
+  return Mix(h ^ (x + 0x9e3779b97f4a7c15ull + (h << 6) + (h >> 2)));
+}
+
+TransductionCache::TransductionCache(string const &dir, long long nMaxBytes, int nMaxEntries, int nVerbose): dir(dir), nMaxBytes(nMaxBytes), nMaxEntries(nMaxEntries), nVerbose(nVerbose), nBytes(0), tick(0) {
+  mkdir(dir.c_str(), 0755);
+  ReadIndex();
+  Evict();
+}
+
+// Hash is invariant under renumbering of nodes, swapping of fanins, and
+// logic not reachable from the outputs. Two independent 64-bit hashes are
+// computed to make collisions negligible.
+string TransductionCache::Hash(aigman const &aig) {
+  stringstream ss;
+  ss << hex << setfill('0');
+  for(unsigned long long seed = 1; seed <= 2; seed++) {
+    vector<unsigned long long> v(aig.nObjs);
+    v[0] = Combine(seed, 0);
+    for(int i = 0; i < aig.nPis; i++)
+      v[i + 1] = Combine(seed, i + 1);
+    for(int i = aig.nPis + 1; i < aig.nObjs; i++) {
+      unsigned long long a = Combine(v[aig.vObjs[i + i] >> 1], aig.vObjs[i + i] & 1);
+      unsigned long long b = Combine(v[aig.vObjs[i + i + 1] >> 1], aig.vObjs[i + i + 1] & 1);
+      v[i] = a < b? Combine(Combine(seed, a), b): Combine(Combine(seed, b), a);
+    }
+    unsigned long long h = Combine(seed, aig.nPis);
+    for(int i = 0; i < aig.nPos; i++)
+      h = Combine(h, Combine(v[aig.vPos[i] >> 1], aig.vPos[i] & 1));
+    ss << setw(16) << h;
+  }
+  return ss.str();
+}
+
+string TransductionCache::Key(aigman const &aig, int nSortType, int nPiShuffle, bool fLevel, bool fFirstMerge, bool fMspfMerge, bool fMspfResub, bool fInner, bool fOuter) {
+  stringstream ss;
+  ss << Hash(aig) << "_" << aig.nPis << "_" << aig.nPos << "_" << nSortType << "_" << nPiShuffle << "_" << fLevel << fFirstMerge << fMspfMerge << fMspfResub << fInner << fOuter;
+  return ss.str();
+}
+
+bool TransductionCache::Lookup(string const &key, aigman &aig) {
+  map<string, Entry>::iterator it = entries.find(key);
+  if(it == entries.end()) {
+    if(nVerbose)
+      cout << "Cache miss " << key << endl;
+    return false;
+  }
+  long long nBytes_;
+  unsigned long long checksum;
+  if(!Checksum(EntryPath(key), nBytes_, checksum) || nBytes_ != it->second.nBytes || checksum != it->second.checksum) {
+    if(nVerbose)
+      cout << "Cache entry corrupted " << key << endl;
+    Erase(key);
+    WriteIndex();
+    return false;
+  }
+  aigman aig_(EntryPath(key));
+  if(aig_.nPis != aig.nPis || aig_.nPos != aig.nPos) {
+    if(nVerbose)
+      cout << "Cache entry mismatched " << key << endl;
+    Erase(key);
+    WriteIndex();
+    return false;
+  }
+  if(nVerbose)
+    cout << "Cache hit " << key << endl;
+  aig = aig_;
+  it->second.tick = ++tick;
+  WriteIndex();
+  return true;
+}
+
+// A file that cannot be checksummed is removed along with any old entry,
+// so that the size total only counts files in the index.
+void TransductionCache::Insert(string const &key, aigman &aig) {
+  string filename = EntryPath(key);
+  string tmpname = TempPath(filename);
+  aig.write(tmpname);
+  if(rename(tmpname.c_str(), filename.c_str())) {
+    remove(tmpname.c_str());
+    return;
+  }
+  Entry e;
+  if(!Checksum(filename, e.nBytes, e.checksum)) {
+    if(entries.count(key))
+      Erase(key);
+    else
+      remove(filename.c_str());
+    WriteIndex();
+    return;
+  }
+  if(entries.count(key))
+    nBytes -= entries[key].nBytes;
+  e.tick = ++tick;
+  entries[key] = e;
+  nBytes += e.nBytes;
+  if(nVerbose)
+    cout << "Cache insert " << key << " (" << e.nBytes << " bytes)" << endl;
+  Evict();
+  WriteIndex();
+}
+
+string TransductionCache::EntryPath(string const &key) const {
+  return dir + "/" + key + ".aig";
+}
+// Temporary files are named per process so that processes sharing the
+// cache do not write into each other's files before renaming.
+string TransductionCache::TempPath(string const &filename) {
+  return filename + "." + to_string(getpid()) + ".tmp";
+}
+
+// Entries already known are kept as they are, and entries whose file is
+// gone are skipped, so that rereading picks up only what other processes
+// inserted meanwhile.
+void TransductionCache::ReadIndex() {
+  ifstream f(dir + "/index");
+  string key;
+  Entry e;
+  struct stat st;
+  while(f >> key >> e.nBytes >> e.checksum >> e.tick) {
+    if(entries.count(key) || stat(EntryPath(key).c_str(), &st))
+      continue;
+    entries[key] = e;
+    nBytes += e.nBytes;
+    tick = max(tick, e.tick);
+  }
+}
+void TransductionCache::WriteIndex() {
+  ReadIndex();
+  string filename = dir + "/index";
+  string tmpname = TempPath(filename);
+  {
+    ofstream f(tmpname);
+    for(map<string, Entry>::const_iterator it = entries.begin(); it != entries.end(); it++)
+      f << it->first << " " << it->second.nBytes << " " << it->second.checksum << " " << it->second.tick << endl;
+  }
+  if(rename(tmpname.c_str(), filename.c_str()))
+    remove(tmpname.c_str());
+}
+
+void TransductionCache::Erase(string const &key) {
+  remove(EntryPath(key).c_str());
+  nBytes -= entries[key].nBytes;
+  entries.erase(key);
+}
+void TransductionCache::Evict() {
+  while(!entries.empty() && (nBytes > nMaxBytes || (int)entries.size() > nMaxEntries)) {
+    map<string, Entry>::iterator lru = entries.begin();
+    for(map<string, Entry>::iterator it = entries.begin(); it != entries.end(); it++)
+      if(it->second.tick < lru->second.tick)
+        lru = it;
+    if(nVerbose)
+      cout << "Cache evict " << lru->first << endl;
+    Erase(lru->first);
+  }
+}
+
+// FNV-1a over the file contents
+bool TransductionCache::Checksum(string const &filename, long long &nBytes, unsigned long long &checksum) {
+  ifstream f(filename, ios::binary);
+  if(!f)
+    return false;
+  nBytes = 0;
+  checksum = 0xcbf29ce484222325ull;
+  char buf[4096];
+  while(f.read(buf, sizeof(buf)) || f.gcount()) {
+    for(streamsize i = 0; i < f.gcount(); i++) {
+      checksum ^= (unsigned char)buf[i];
+      checksum *= 0x100000001b3ull;
+    }
+    nBytes += f.gcount();
+  }
+  return true;
+}
@@ -0,0 +1,255 @@
+#include <iostream>
+#include <algorithm>
+#include <random>
+#include <stdexcept>
+
+#include "TransductionCec.h"
+
+using namespace std;
+
+TransductionCec::TransductionCec(aigman const &aig0, aigman const &aig1, int nVerbose): nVerbose(nVerbose), nPis(aig0.nPis), nWords(0), nCexs(0), fDeadline(false), iFailedPo(-1) {
+  if(aig0.nPis != aig1.nPis || aig0.nPos != aig1.nPos)
+    throw runtime_error("interfaces of the two aigs differ");
+  vFanins.resize(2 * (nPis + 1));
+  Import(aig0, vPos0);
+  Import(aig1, vPos1);
+}
+
+int TransductionCec::And(int a, int b) {
+  if(a > b)
+    swap(a, b);
+  if(a == 0 || a == (b ^ 1))
+    return 0;
+  if(a == 1 || a == b)
+    return b;
+  map<pair<int, int>, int>::iterator it = strash.find(make_pair(a, b));
+  if(it != strash.end())
+    return it->second;
+  int r = vFanins.size();
+  vFanins.push_back(a);
+  vFanins.push_back(b);
+  strash[make_pair(a, b)] = r;
+  return r;
+}
+
+void TransductionCec::Import(aigman const &aig, vector<int> &vPos) {
+  vector<int> vMap(aig.nObjs);
+  for(int i = 0; i <= aig.nPis; i++)
+    vMap[i] = i << 1;
+  for(int i = aig.nPis + 1; i < aig.nObjs; i++) {
+    int a = vMap[aig.vObjs[i + i] >> 1] ^ (aig.vObjs[i + i] & 1);
+    int b = vMap[aig.vObjs[i + i + 1] >> 1] ^ (aig.vObjs[i + i + 1] & 1);
+    vMap[i] = And(a, b);
+  }
+  vPos.resize(aig.nPos);
+  for(int i = 0; i < aig.nPos; i++)
+    vPos[i] = vMap[aig.vPos[i] >> 1] ^ (aig.vPos[i] & 1);
+}
+
+void TransductionCec::Simulate() {
+  int nObjs = vFanins.size() / 2;
+  vSims.resize((size_t)nObjs * nWords);
+  for(int i = nPis + 1; i < nObjs; i++) {
+    int a = vFanins[i + i], b = vFanins[i + i + 1];
+    word ca = (a & 1)? ~0ull: 0, cb = (b & 1)? ~0ull: 0;
+    for(int k = 0; k < nWords; k++)
+      vSims[(size_t)i * nWords + k] = (vSims[(size_t)(a >> 1) * nWords + k] ^ ca) & (vSims[(size_t)(b >> 1) * nWords + k] ^ cb);
+  }
+}
+
+// Record the pis of the last satisfying assignment. Every 64 patterns are
+// appended to the signatures as one more word, returning true if so.
+bool TransductionCec::AddPattern() {
+  vCexSims.resize(nPis + 1);
+  int p = nCexs++ % 64;
+  for(int i = 1; i <= nPis; i++)
+    if(i < (int)vVars.size() && vVars[i] != -1 && sat.Value(vVars[i]))
+      vCexSims[i] |= 1ull << p;
+  if(p != 63)
+    return false;
+  int nObjs = vFanins.size() / 2;
+  vector<word> vSimsOld;
+  vSimsOld.swap(vSims);
+  vSims.resize((size_t)nObjs * (nWords + 1));
+  for(int i = 0; i <= nPis; i++) {
+    copy(vSimsOld.begin() + (size_t)i * nWords, vSimsOld.begin() + (size_t)(i + 1) * nWords, vSims.begin() + (size_t)i * (nWords + 1));
+    vSims[(size_t)i * (nWords + 1) + nWords] = vCexSims[i];
+  }
+  nWords++;
+  vCexSims.clear();
+  Simulate();
+  return true;
+}
+
+bool TransductionCec::CheckPos() {
+  for(unsigned j = 0; j < vPos0.size(); j++) {
+    int a = vPos0[j], b = vPos1[j];
+    if(a == b)
+      continue;
+    word c = ((a ^ b) & 1)? ~0ull: 0;
+    for(int k = 0; k < nWords; k++) {
+      word d = vSims[(size_t)(a >> 1) * nWords + k] ^ vSims[(size_t)(b >> 1) * nWords + k] ^ c;
+      if(!d)
+        continue;
+      int p = 0;
+      while(!((d >> p) & 1))
+        p++;
+      iFailedPo = j;
+      vCex.resize(nPis);
+      for(int i = 0; i < nPis; i++)
+        vCex[i] = (vSims[(size_t)(i + 1) * nWords + k] >> p) & 1;
+      return false;
+    }
+  }
+  return true;
+}
+
+// Signature of node i normalized to have the first bit 0.
+void TransductionCec::Signature(int i, vector<word> &vSig) const {
+  vSig.assign(vSims.begin() + (size_t)i * nWords, vSims.begin() + (size_t)(i + 1) * nWords);
+  if(vSig[0] & 1)
+    for(int k = 0; k < nWords; k++)
+      vSig[k] = ~vSig[k];
+}
+
+// Prove nodes equivalent to the first node with the same signature, adding
+// the equivalences as clauses so that later proofs reduce to propagation.
+// A failed proof adds its counterexample to the patterns.
+void TransductionCec::Sweep(long long nConfLimit) {
+  int nObjs = vFanins.size() / 2;
+  map<vector<word>, int> classes;
+  vector<word> vSig;
+  int nProved = 0, nFailed = 0;
+  for(int i = 0; i < nObjs && !TimedOut(); i++) {
+    Signature(i, vSig);
+    pair<map<vector<word>, int>::iterator, bool> r = classes.insert(make_pair(vSig, i));
+    if(r.second)
+      continue;
+    int j = r.first->second;
+    bool c = (vSims[(size_t)i * nWords] ^ vSims[(size_t)j * nWords]) & 1;
+    int a = Encode(j << 1);
+    int b = Encode((i << 1) ^ c);
+    int s = sat.Solve({a, b ^ 1}, nConfLimit);
+    if(s == 0)
+      s = sat.Solve({a ^ 1, b}, nConfLimit);
+    if(s == 0) {
+      sat.AddClause({a ^ 1, b});
+      sat.AddClause({a, b ^ 1});
+      nProved++;
+      continue;
+    }
+    if(s == -1)
+      continue;
+    nFailed++;
+    if(AddPattern()) {
+      classes.clear();
+      for(int k = 0; k <= i; k++) {
+        Signature(k, vSig);
+        classes.insert(make_pair(vSig, k));
+      }
+    }
+  }
+  if(nVerbose)
+    cout << "Cec: " << nProved << " nodes merged, " << nFailed << " disproved" << endl;
+}
+
+// Tseitin encoding of the cone of x, returning the solver literal.
+int TransductionCec::Encode(int x) {
+  vVars.resize(vFanins.size() / 2, -1);
+  vector<int> vStack(1, x >> 1);
+  while(!vStack.empty()) {
+    int i = vStack.back();
+    if(vVars[i] != -1) {
+      vStack.pop_back();
+      continue;
+    }
+    if(i == 0) {
+      vVars[i] = sat.NewVar();
+      sat.AddClause(vector<int>(1, (vVars[i] << 1) ^ 1));
+      continue;
+    }
+    if(i <= nPis) {
+      vVars[i] = sat.NewVar();
+      continue;
+    }
+    int a = vFanins[i + i], b = vFanins[i + i + 1];
+    if(vVars[a >> 1] == -1 || vVars[b >> 1] == -1) {
+      if(vVars[a >> 1] == -1)
+        vStack.push_back(a >> 1);
+      if(vVars[b >> 1] == -1)
+        vStack.push_back(b >> 1);
+      continue;
+    }
+    int z = sat.NewVar() << 1;
+    int la = (vVars[a >> 1] << 1) ^ (a & 1);
+    int lb = (vVars[b >> 1] << 1) ^ (b & 1);
+    sat.AddClause({z ^ 1, la});
+    sat.AddClause({z ^ 1, lb});
+    sat.AddClause({z, la ^ 1, lb ^ 1});
+    vVars[i] = z >> 1;
+  }
+  return (vVars[x >> 1] << 1) ^ (x & 1);
+}
+
+int TransductionCec::Check(double nSeconds, int nSimWords, long long nSweepConfs) {
+  if(nSeconds > 0) {
+    fDeadline = true;
+    deadline = chrono::steady_clock::now() + chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<double>(nSeconds));
+    sat.SetDeadline(deadline);
+  }
+  nWords = max(nSimWords, 1);
+  vSims.assign((vFanins.size() / 2) * nWords, 0);
+  mt19937_64 rng(vFanins.size());
+  for(size_t k = nWords; k < (size_t)(nPis + 1) * nWords; k++)
+    vSims[k] = rng();
+  Simulate();
+  if(nSimWords > 0 && !CheckPos()) {
+    if(nVerbose)
+      cout << "Cec: po " << iFailedPo << " differs in simulation" << endl;
+    return 0;
+  }
+  if(nSweepConfs > 0)
+    Sweep(nSweepConfs);
+  bool fUndecided = false;
+  int nProved = 0;
+  for(unsigned j = 0; j < vPos0.size(); j++) {
+    if(vPos0[j] == vPos1[j])
+      continue;
+    int a = Encode(vPos0[j]);
+    int b = Encode(vPos1[j]);
+    int d = sat.NewVar() << 1;
+    sat.AddClause({d ^ 1, a, b});
+    sat.AddClause({d ^ 1, a ^ 1, b ^ 1});
+    sat.AddClause({d, a ^ 1, b});
+    sat.AddClause({d, a, b ^ 1});
+    int r = sat.Solve(vector<int>(1, d));
+    if(r == 1) {
+      iFailedPo = j;
+      vCex.resize(nPis);
+      for(int i = 0; i < nPis; i++)
+        vCex[i] = i + 1 < (int)vVars.size() && vVars[i + 1] != -1 && sat.Value(vVars[i + 1]);
+      if(nVerbose)
+        cout << "Cec: po " << j << " differs" << endl;
+      return 0;
+    }
+    if(r == 0) {
+      sat.AddClause(vector<int>(1, d ^ 1));
+      nProved++;
+    } else
+      fUndecided = true;
+  }
+  if(nVerbose)
+    cout << "Cec: " << nProved << " pos proved by SAT, " << sat.NumVars() << " vars" << (fUndecided? ", undecided": "") << endl;
+  return fUndecided? -1: 1;
+}
+
+bool TransductionCec::TimedOut() const {
+  return fDeadline && chrono::steady_clock::now() > deadline;
+}
+
+int TransductionCec::FailedPo() const {
+  return iFailedPo;
+}
+vector<bool> const &TransductionCec::Cex() const {
+  return vCex;
+}
@@ -0,0 +1,183 @@
+#include <iostream>
+#include <fstream>
+#include <stdexcept>
+#include <cstdio>
+
+#include "Transduction.h"
+
+using namespace std;
+
+// A checkpoint holds the network structure and the level constraint.
+// Functions are rebuilt on load, and permissible functions are recomputed
+// by the next Cspf or Mspf. Since version 2 it also holds the gates left
+// out of an eco region, which is empty otherwise.
+Transduction::Transduction(string const &filename, int nVerbose): nVerbose(nVerbose), nGbc(1), nReo(4000), nVarOrder(0) {
+  ifstream f(filename);
+  if(!f)
+    throw runtime_error("cannot open " + filename);
+  ReadCheckpoint(f);
+}
+
+void Transduction::SetCheckpoint(string const &filename) {
+  checkpoint = filename;
+}
+
+void Transduction::WriteCheckpoint(string const &filename) const {
+  if(Verbose(2))
+    cout << "\tWrite checkpoint " << filename << endl;
+  TRANSDUCTION_TRACE_SCOPE("WriteCheckpoint");
+  // The file is written aside and renamed over the old one only when
+  // complete, so that a failed write keeps the last good checkpoint.
+  string tmpname = filename + ".tmp";
+  {
+    ofstream f(tmpname);
+    f << "transduction 2" << endl;
+    f << vPis.size() << " " << vPos.size() << " " << nObjsAlloc << " " << nSortType << " " << fLevel << " " << nMaxLevels << endl;
+    for(unsigned i = 0; i < vPis.size(); i++)
+      f << vPis[i] << " ";
+    f << endl;
+    for(unsigned i = 0; i < vPos.size(); i++)
+      f << vPos[i] << " ";
+    f << endl;
+    f << vObjs.size() << endl;
+    for(list<int>::const_iterator it = vObjs.begin(); it != vObjs.end(); it++) {
+      f << *it << " " << vvFis[*it].size();
+      for(unsigned j = 0; j < vvFis[*it].size(); j++)
+        f << " " << vvFis[*it][j];
+      f << endl;
+    }
+    for(unsigned i = 0; i < vPos.size(); i++)
+      f << vvFis[vPos[i]][0] << endl;
+    int nFrozen = 0;
+    for(list<int>::const_iterator it = vObjs.begin(); it != vObjs.end(); it++)
+      nFrozen += vFrozen[*it];
+    f << nFrozen;
+    for(list<int>::const_iterator it = vObjs.begin(); it != vObjs.end(); it++)
+      if(vFrozen[*it])
+        f << " " << *it;
+    f << endl;
+    f << aigFixed.nObjs << " " << aigFixed.nPos << endl;
+    for(int i = aigFixed.nPis + 1; i < aigFixed.nObjs; i++)
+      f << aigFixed.vObjs[i + i] << " " << aigFixed.vObjs[i + i + 1] << endl;
+    for(int i = 0; i < aigFixed.nPos; i++)
+      f << aigFixed.vPos[i] << " ";
+    f << endl;
+    f.close();
+    if(!f) {
+      remove(tmpname.c_str());
+      throw runtime_error("cannot write " + tmpname);
+    }
+  }
+  if(rename(tmpname.c_str(), filename.c_str())) {
+    remove(tmpname.c_str());
+    throw runtime_error("cannot rename " + tmpname + " to " + filename);
+  }
+}
+
+void Transduction::ReadCheckpoint(istream &is) {
+  string magic;
+  int version;
+  is >> magic >> version;
+  if(magic != "transduction" || (version != 1 && version != 2))
+    throw runtime_error("not a transduction checkpoint");
+  int nPis, nPos;
+  is >> nPis >> nPos >> nObjsAlloc >> nSortType >> fLevel >> nMaxLevels;
+  if(!is || nPis < 0 || nPos < 0 || nObjsAlloc < nPis + nPos + 1)
+    throw runtime_error("malformed checkpoint");
+  nTravIds = 0;
+  nVisits = 0;
+  nWires = 0;
+  nEpoch = 0;
+  nLevels = 0;
+  nSimWords = 0;
+  nSimCexs = 0;
+  nMspfWindow = 0;
+  fPrioritize = false;
+  nMinYield = 0;
+  nResubThreads = 0;
+  nIdSpace = 0;
+  nIdSpaces = 0;
+  vStartupSecs.clear();
+  lapTime = chrono::steady_clock::now();
+  NewMan(nPis);
+  Allocate();
+  vPis.resize(nPis);
+  for(int i = 0; i < nPis; i++)
+    is >> vPis[i];
+  vPos.resize(nPos);
+  for(int i = 0; i < nPos; i++) {
+    is >> vPos[i];
+    if(!is || vPos[i] <= nPis || vPos[i] >= nObjsAlloc)
+      throw runtime_error("malformed checkpoint");
+    vIsPo[vPos[i]] = true;
+  }
+  int nObjs;
+  is >> nObjs;
+  for(int i = 0; is && i < nObjs; i++) {
+    int id, nFis;
+    is >> id >> nFis;
+    if(!is || id <= nPis || id >= nObjsAlloc)
+      throw runtime_error("malformed checkpoint");
+    vObjs.push_back(id);
+    for(int j = 0; j < nFis; j++) {
+      int f;
+      is >> f;
+      if(!is || (f >> 1) >= nObjsAlloc)
+        throw runtime_error("malformed checkpoint");
+      Connect(id, f);
+    }
+  }
+  for(int i = 0; is && i < nPos; i++) {
+    int f;
+    is >> f;
+    if(!is || (f >> 1) >= nObjsAlloc)
+      throw runtime_error("malformed checkpoint");
+    Connect(vPos[i], f);
+  }
+  int nFrozen;
+  is >> nFrozen;
+  for(int i = 0; is && i < nFrozen; i++) {
+    int id;
+    is >> id;
+    if(id >= 0 && id < nObjsAlloc)
+      vFrozen[id] = true;
+  }
+  aigFixed.clear();
+  if(version >= 2) {
+    int nFixedObjs, nFixedPos;
+    is >> nFixedObjs >> nFixedPos;
+    if(!is || nFixedPos < 0 || nFixedPos > nPis || (nFixedPos && nFixedObjs < nPis - nFixedPos + 1))
+      throw runtime_error("malformed checkpoint");
+    if(nFixedPos) {
+      aigFixed.nPis = nPis - nFixedPos;
+      aigFixed.nObjs = aigFixed.nPis + 1;
+      aigFixed.vObjs.resize(aigFixed.nObjs * 2);
+      for(int i = aigFixed.nPis + 1; is && i < nFixedObjs; i++) {
+        int f0, f1;
+        is >> f0 >> f1;
+        if(!is || (f0 >> 1) >= i || (f1 >> 1) >= i)
+          throw runtime_error("malformed checkpoint");
+        aigFixed.newgate(f0, f1);
+      }
+      for(int i = 0; is && i < nFixedPos; i++) {
+        int f;
+        is >> f;
+        if(!is || (f >> 1) >= nFixedObjs)
+          throw runtime_error("malformed checkpoint");
+        aigFixed.vPos.push_back(f);
+        aigFixed.nPos++;
+      }
+    }
+  }
+  if(!is)
+    throw runtime_error("malformed checkpoint");
+  Lap("ReadCheckpoint");
+  Setup();
+  state = PfState::none;
+  if(fLevel) {
+    if(aigFixed.nPos)
+      SetFixedLevels();
+    ComputeLevel();
+    Lap("ComputeLevel");
+  }
+}
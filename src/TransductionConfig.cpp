@@ -0,0 +1,66 @@
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+#include "TransductionConfig.h"
+
+using namespace std;
+
+void TransductionConfig::Read(string const &filename) {
+  ifstream f(filename);
+  if(!f)
+    throw runtime_error("cannot open " + filename);
+  Read(f);
+}
+
+void TransductionConfig::Read(istream &is) {
+  string line;
+  while(getline(is, line)) {
+    line = line.substr(0, line.find('#'));
+    stringstream ss(line);
+    string name;
+    if(!(ss >> name))
+      continue;
+    int value;
+    if(!(ss >> value))
+      throw runtime_error("missing value of " + name);
+    if(name == "nSortType")
+      nSortType = value;
+    else if(name == "nPiShuffle")
+      nPiShuffle = value;
+    else if(name == "fLevel")
+      fLevel = value;
+    else if(name == "fFirstMerge")
+      fFirstMerge = value;
+    else if(name == "fMspfMerge")
+      fMspfMerge = value;
+    else if(name == "fMspfResub")
+      fMspfResub = value;
+    else if(name == "fInner")
+      fInner = value;
+    else if(name == "fOuter")
+      fOuter = value;
+    else if(name == "nGbc")
+      nGbc = value;
+    else if(name == "nReo")
+      nReo = value;
+    else if(name == "nVarOrder")
+      nVarOrder = value;
+    else
+      throw runtime_error("unknown parameter " + name);
+  }
+}
+
+void TransductionConfig::Write(ostream &os) const {
+  os << "nSortType " << nSortType << endl;
+  os << "nPiShuffle " << nPiShuffle << endl;
+  os << "fLevel " << fLevel << endl;
+  os << "fFirstMerge " << fFirstMerge << endl;
+  os << "fMspfMerge " << fMspfMerge << endl;
+  os << "fMspfResub " << fMspfResub << endl;
+  os << "fInner " << fInner << endl;
+  os << "fOuter " << fOuter << endl;
+  os << "nGbc " << nGbc << endl;
+  os << "nReo " << nReo << endl;
+  os << "nVarOrder " << nVarOrder << endl;
+}
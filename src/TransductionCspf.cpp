@@ -10,17 +10,15 @@ int Transduction::RemoveRedundantFis(int i, int block_i0, unsigned j) {
   for(; j < vvFis[i].size(); j++) {
     if(block_i0 == (vvFis[i][j] >> 1))
       continue;
-    lit x = man->Const1();
-    IncRef(x);
+    vector<lit> vLits;
     for(unsigned jj = 0; jj < vvFis[i].size(); jj++)
       if(j != jj)
-        Update(x, man->And(x, LitFi(i, jj)));
-    Update(x, man->Or(man->LitNot(x), vGs[i]));
-    Update(x, man->Or(x, LitFi(i, j)));
-    DecRef(x);
-    if(man->IsConst1(x)) {
+        vLits.push_back(LitFi(i, jj));
+    LitRef x(man, AndAll(vLits));
+    x = man->Or(man->LitNot(x), vGs[i]);
+    if(Implies(man->LitNot(x), LitFi(i, j))) {
       int i0 = vvFis[i][j] >> 1;
-      if(nVerbose > 4)
+      if(Verbose(5))
         cout << "\t\t\t\tRRF remove wire " << i0 << "(" << (vvFis[i][j] & 1) << ")" << " -> " << i << endl;
       Disconnect(i, i0, j--);
       count++;
@@ -30,40 +28,44 @@ int Transduction::RemoveRedundantFis(int i, int block_i0, unsigned j) {
 }
 
 void Transduction::CalcG(int i) {
-  Update(vGs[i], man->Const1());
+  vector<lit> vLits;
   for(unsigned j = 0; j < vvFos[i].size(); j++) {
     int k = vvFos[i][j];
-    int l = FindFi(k, i);
-    assert(l >= 0);
-    Update(vGs[i], man->And(vGs[i], vvCs[k][l]));
+    if(vFrozen[k]) {
+      vGs.Set(i, man->Const0());
+      return;
+    }
+    vLits.push_back(vvCs[k][FindFi(i, j)]);
   }
+  vGs.Set(i, AndAll(vLits));
 }
 
 int Transduction::CalcC(int i) {
   int count = 0;
   for(unsigned j = 0; j < vvFis[i].size(); j++) {
-    lit x = man->Const1();
-    IncRef(x);
+    vector<lit> vLits;
     for(unsigned jj = j + 1; jj < vvFis[i].size(); jj++)
-      Update(x, man->And(x, LitFi(i, jj)));
-    Update(x, man->Or(man->LitNot(x), vGs[i]));
+      vLits.push_back(LitFi(i, jj));
+    LitRef x(man, AndAll(vLits));
+    x = man->Or(man->LitNot(x), vGs[i]);
     int i0 = vvFis[i][j] >> 1;
-    if(man->IsConst1(man->Or(x, LitFi(i, j)))) {
-      if(nVerbose > 4)
+    if(Implies(man->LitNot(x), LitFi(i, j))) {
+      if(Verbose(5))
         cout << "\t\t\t\tCspf remove wire " << i0 << "(" << (vvFis[i][j] & 1) << ")" << " -> " << i << endl;
       Disconnect(i, i0, j--);
       count++;
     } else if(vvCs[i][j] != x) {
-      Update(vvCs[i][j], x);
+      vvCs[i].Set(j, std::move(x));
       vPfUpdates[i0] = true;
     }
-    DecRef(x);
   }
   return count;
 }
 
 int Transduction::Cspf(bool fSortRemove, int block, int block_i0) {
-  if(nVerbose > 2) {
+  TRANSDUCTION_TRACE_SCOPE_ARG("Cspf", block);
+  TRANSDUCTION_PERF_SCOPE("Cspf");
+  if(Verbose(3)) {
     cout << "\t\tCspf";
     if(block_i0 != -1)
       cout << " (block " << block_i0 << " -> " << block << ")";
@@ -75,20 +77,23 @@ int Transduction::Cspf(bool fSortRemove, int block, int block_i0) {
     for(list<int>::iterator it = vObjs.begin(); it != vObjs.end(); it++)
       vPfUpdates[*it] = true;
   state = PfState::cspf;
+  if(fSortRemove)
+    RankObjs();
   int count = 0;
   for(list<int>::reverse_iterator it = vObjs.rbegin(); it != vObjs.rend();) {
     if(vvFos[*it].empty()) {
-      if(nVerbose > 3)
+      if(Verbose(4))
         cout << "\t\t\tRemove unused " << *it << endl;
       count += Remove(*it);
       it = list<int>::reverse_iterator(vObjs.erase(--(it.base())));
       continue;
     }
-    if(!vPfUpdates[*it]) {
+    if(!vPfUpdates[*it] || vFrozen[*it]) {
+      vPfUpdates[*it] = false;
       it++;
       continue;
     }
-    if(nVerbose > 3)
+    if(Verbose(4))
       cout << "\t\t\tCspf " << *it << endl;
     CalcG(*it);
     if(fSortRemove) {
@@ -115,14 +120,11 @@ int Transduction::Cspf(bool fSortRemove, int block, int block_i0) {
 }
 
 bool Transduction::CspfDebug() {
-  vector<lit> vGsOld;
-  CopyVec(vGsOld, vGs);
-  vector<vector<lit> > vvCsOld;
-  CopyVec(vvCsOld, vvCs);
+  LitVec vGsOld;
+  vGsOld.Assign(vGs);
+  vector<LitVec> vvCsOld;
+  LitVec::Assign(vvCsOld, vvCs);
   state = PfState::none;
   Cspf();
-  bool r = vGsOld == vGs && vvCsOld == vvCs;
-  DelVec(vGsOld);
-  DelVec(vvCsOld);
-  return r;
+  return vGsOld == vGs && vvCsOld == vvCs;
 }
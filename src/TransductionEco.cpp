@@ -0,0 +1,207 @@
+#include <iostream>
+#include <map>
+#include <algorithm>
+#include <cassert>
+
+#include "Transduction.h"
+
+using namespace std;
+
+static void MarkCone(aigman const &aig, int x, vector<bool> &vMarks) {
+  vector<int> vStack(1, x >> 1);
+  while(!vStack.empty()) {
+    int i = vStack.back();
+    vStack.pop_back();
+    if(vMarks[i])
+      continue;
+    vMarks[i] = true;
+    if(i > aig.nPis) {
+      vStack.push_back(aig.vObjs[i + i] >> 1);
+      vStack.push_back(aig.vObjs[i + i + 1] >> 1);
+    }
+  }
+}
+
+static int StrashAnd(aigman &aig, map<pair<int, int>, int> &strash, int a, int b) {
+  if(a > b)
+    swap(a, b);
+  if(a == 0 || a == (b ^ 1))
+    return 0;
+  if(a == 1 || a == b)
+    return b;
+  map<pair<int, int>, int>::iterator it = strash.find(make_pair(a, b));
+  if(it != strash.end())
+    return it->second;
+  int r = aig.newgate(a, b) << 1;
+  strash[make_pair(a, b)] = r;
+  return r;
+}
+
+// Combine the previous optimization result with the modified design.
+// A node of aig is unchanged if it structurally matches a node of aigOld,
+// and a po is unchanged if its driver matches the same po of aigOld.
+// Unchanged pos are taken from aigOpt, the others from aig, and vChanged
+// marks the nodes of aigEco which came from unmatched nodes of aig.
+void Transduction::MergeEco(aigman const &aig, aigman const &aigOld, aigman const &aigOpt, aigman &aigEco, vector<bool> &vChanged) {
+  assert(aig.nPis == aigOpt.nPis && aig.nPos == aigOpt.nPos);
+  vector<int> vOld(aig.nObjs, -1);
+  vector<bool> vPoChanged(aig.nPos, true);
+  if(aig.nPis == aigOld.nPis && aig.nPos == aigOld.nPos) {
+    map<pair<int, int>, int> strash;
+    for(int i = aigOld.nPis + 1; i < aigOld.nObjs; i++) {
+      pair<int, int> p = minmax(aigOld.vObjs[i + i], aigOld.vObjs[i + i + 1]);
+      if(!strash.count(p))
+        strash[p] = i << 1;
+    }
+    for(int i = 0; i <= aig.nPis; i++)
+      vOld[i] = i << 1;
+    for(int i = aig.nPis + 1; i < aig.nObjs; i++) {
+      int a = vOld[aig.vObjs[i + i] >> 1];
+      int b = vOld[aig.vObjs[i + i + 1] >> 1];
+      if(a == -1 || b == -1)
+        continue;
+      pair<int, int> p = minmax(a ^ (aig.vObjs[i + i] & 1), b ^ (aig.vObjs[i + i + 1] & 1));
+      map<pair<int, int>, int>::iterator it = strash.find(p);
+      if(it != strash.end())
+        vOld[i] = it->second;
+    }
+    for(int i = 0; i < aig.nPos; i++) {
+      int a = vOld[aig.vPos[i] >> 1];
+      vPoChanged[i] = a == -1 || (a ^ (aig.vPos[i] & 1)) != aigOld.vPos[i];
+    }
+  }
+  vector<bool> vMarks(aig.nObjs);
+  vector<bool> vMarksOpt(aigOpt.nObjs);
+  for(int i = 0; i < aig.nPos; i++) {
+    if(vPoChanged[i])
+      MarkCone(aig, aig.vPos[i], vMarks);
+    else
+      MarkCone(aigOpt, aigOpt.vPos[i], vMarksOpt);
+  }
+  aigEco.clear();
+  aigEco.nPis = aig.nPis;
+  aigEco.nObjs = aigEco.nPis + 1;
+  aigEco.vObjs.resize(aigEco.nObjs * 2);
+  map<pair<int, int>, int> strash;
+  vector<int> values(aigOpt.nObjs);
+  for(int i = 0; i <= aigOpt.nPis; i++)
+    values[i] = i << 1;
+  for(int i = aigOpt.nPis + 1; i < aigOpt.nObjs; i++)
+    if(vMarksOpt[i])
+      values[i] = StrashAnd(aigEco, strash, values[aigOpt.vObjs[i + i] >> 1] ^ (aigOpt.vObjs[i + i] & 1), values[aigOpt.vObjs[i + i + 1] >> 1] ^ (aigOpt.vObjs[i + i + 1] & 1));
+  vChanged.clear();
+  vChanged.resize(aigEco.nObjs);
+  vector<int> valuesNew(aig.nObjs);
+  for(int i = 0; i <= aig.nPis; i++)
+    valuesNew[i] = i << 1;
+  for(int i = aig.nPis + 1; i < aig.nObjs; i++)
+    if(vMarks[i]) {
+      valuesNew[i] = StrashAnd(aigEco, strash, valuesNew[aig.vObjs[i + i] >> 1] ^ (aig.vObjs[i + i] & 1), valuesNew[aig.vObjs[i + i + 1] >> 1] ^ (aig.vObjs[i + i + 1] & 1));
+      vChanged.resize(aigEco.nObjs);
+      if(vOld[i] == -1)
+        vChanged[valuesNew[i] >> 1] = true;
+    }
+  for(int i = 0; i < aig.nPos; i++) {
+    if(vPoChanged[i])
+      aigEco.vPos.push_back(valuesNew[aig.vPos[i] >> 1] ^ (aig.vPos[i] & 1));
+    else
+      aigEco.vPos.push_back(values[aigOpt.vPos[i] >> 1] ^ (aigOpt.vPos[i] & 1));
+    aigEco.nPos++;
+  }
+  for(int i = 0; i <= aigEco.nPis; i++)
+    vChanged[i] = false;
+}
+
+// Separate the gates of aigEco which need not be visited at all: a gate is
+// fixed if it is outside the transitive fanin and fanout of the changed
+// nodes and all its fanins are pis or fixed. aigFixed holds the fixed gates
+// over the original pis, with one po per fixed gate read by aigRegion or
+// by a po. aigRegion holds the other gates, reading the k-th po of aigFixed
+// as an additional pi nPis + 1 + k.
+void Transduction::SplitEco(aigman const &aigEco, vector<bool> const &vChanged, aigman &aigFixed, aigman &aigRegion, vector<bool> &vChangedRegion) {
+  vector<bool> vTfi(aigEco.nObjs), vTfo(aigEco.nObjs);
+  for(int i = aigEco.nPis + 1; i < aigEco.nObjs; i++)
+    if(vChanged[i])
+      MarkCone(aigEco, i << 1, vTfi);
+  vector<bool> vFixed(aigEco.nObjs);
+  for(int i = aigEco.nPis + 1; i < aigEco.nObjs; i++) {
+    int i0 = aigEco.vObjs[i + i] >> 1;
+    int i1 = aigEco.vObjs[i + i + 1] >> 1;
+    vTfo[i] = vChanged[i] || vTfo[i0] || vTfo[i1];
+    vFixed[i] = !vTfi[i] && !vTfo[i] && (i0 <= aigEco.nPis || vFixed[i0]) && (i1 <= aigEco.nPis || vFixed[i1]);
+  }
+  vector<bool> vBoundary(aigEco.nObjs);
+  for(int i = aigEco.nPis + 1; i < aigEco.nObjs; i++)
+    if(!vFixed[i])
+      for(int ii = i + i; ii <= i + i + 1; ii++)
+        vBoundary[aigEco.vObjs[ii] >> 1] = vFixed[aigEco.vObjs[ii] >> 1];
+  for(int i = 0; i < aigEco.nPos; i++)
+    vBoundary[aigEco.vPos[i] >> 1] = vFixed[aigEco.vPos[i] >> 1];
+  aigFixed.clear();
+  aigFixed.nPis = aigEco.nPis;
+  aigFixed.nObjs = aigFixed.nPis + 1;
+  aigFixed.vObjs.resize(aigFixed.nObjs * 2);
+  vector<int> values(aigEco.nObjs);
+  for(int i = 0; i <= aigEco.nPis; i++)
+    values[i] = i << 1;
+  for(int i = aigEco.nPis + 1; i < aigEco.nObjs; i++)
+    if(vFixed[i])
+      values[i] = aigFixed.newgate(values[aigEco.vObjs[i + i] >> 1] ^ (aigEco.vObjs[i + i] & 1), values[aigEco.vObjs[i + i + 1] >> 1] ^ (aigEco.vObjs[i + i + 1] & 1)) << 1;
+  aigRegion.clear();
+  aigRegion.nPis = aigEco.nPis;
+  for(int i = aigEco.nPis + 1; i < aigEco.nObjs; i++)
+    if(vBoundary[i]) {
+      aigFixed.vPos.push_back(values[i]);
+      aigFixed.nPos++;
+      values[i] = ++aigRegion.nPis << 1;
+    }
+  aigRegion.nObjs = aigRegion.nPis + 1;
+  aigRegion.vObjs.resize(aigRegion.nObjs * 2);
+  vChangedRegion.clear();
+  vChangedRegion.resize(aigRegion.nObjs);
+  for(int i = aigEco.nPis + 1; i < aigEco.nObjs; i++)
+    if(!vFixed[i]) {
+      values[i] = aigRegion.newgate(values[aigEco.vObjs[i + i] >> 1] ^ (aigEco.vObjs[i + i] & 1), values[aigEco.vObjs[i + i + 1] >> 1] ^ (aigEco.vObjs[i + i + 1] & 1)) << 1;
+      vChangedRegion.push_back(vChanged[i]);
+    }
+  for(int i = 0; i < aigEco.nPos; i++) {
+    aigRegion.vPos.push_back(values[aigEco.vPos[i] >> 1] ^ (aigEco.vPos[i] & 1));
+    aigRegion.nPos++;
+  }
+}
+
+// Pseudo pis start at the level of the fixed gate they stand for.
+void Transduction::SetFixedLevels() {
+  vector<int> vFixedLevels(aigFixed.nObjs);
+  for(int i = aigFixed.nPis + 1; i < aigFixed.nObjs; i++)
+    vFixedLevels[i] = max(vFixedLevels[aigFixed.vObjs[i + i] >> 1], vFixedLevels[aigFixed.vObjs[i + i + 1] >> 1]) + 1;
+  int nPisOrig = vPis.size() - aigFixed.nPos;
+  for(int k = 0; k < aigFixed.nPos; k++)
+    vLevels[nPisOrig + 1 + k] = vFixedLevels[aigFixed.vPos[k] >> 1];
+}
+
+// Restrict optimization to the transitive fanin and fanout of the changed
+// nodes. Frozen nodes are neither targets of resubstitution nor given
+// permissible functions, they are not merged or decomposed, and their fanin
+// edges are treated as fully observable.
+void Transduction::Freeze(vector<bool> const &vChanged) {
+  vector<bool> vMarks(nObjsAlloc);
+  NewTravId();
+  for(list<int>::iterator it = vObjs.begin(); it != vObjs.end(); it++)
+    if(*it < (int)vChanged.size() && vChanged[*it])
+      MarkFiCone(*it);
+  for(list<int>::iterator it = vObjs.begin(); it != vObjs.end(); it++)
+    vMarks[*it] = IsTravIdCurrent(*it);
+  NewTravId();
+  for(list<int>::iterator it = vObjs.begin(); it != vObjs.end(); it++)
+    if(*it < (int)vChanged.size() && vChanged[*it])
+      MarkFoCone(*it);
+  int count = 0;
+  for(list<int>::iterator it = vObjs.begin(); it != vObjs.end(); it++)
+    if(!vMarks[*it] && !IsTravIdCurrent(*it)) {
+      vFrozen[*it] = true;
+      count++;
+    }
+  if(Verbose(1))
+    cout << "Eco: " << vObjs.size() - count << " of " << vObjs.size() << " gates in changed region" << endl;
+}
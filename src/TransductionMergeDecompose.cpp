@@ -8,88 +8,88 @@
 using namespace std;
 
 int Transduction::TrivialMergeOne(int i) {
-  if(nVerbose > 3)
+  if(Verbose(4))
     cout << "\t\t\tTrivial merge " << i << endl;
+  if(vFrozen[i])
+    return 0;
   int count = 0;
-  vector<int> vFisOld = vvFis[i];
-  vector<lit> vCsOld = vvCs[i];
-  vvFis[i].clear();
-  vvCs[i].clear();
-  for(unsigned j = 0; j < vFisOld.size(); j++) {
-    int i0 = vFisOld[j] >> 1;
-    int c0 = vFisOld[j] & 1;
-    if(vvFis[i0].empty() || vvFos[i0].size() > 1 || c0) {
-      if(nVerbose > 5)
+  for(unsigned j = 0; j < vvFis[i].size(); j++) {
+    int i0 = vvFis[i][j] >> 1;
+    int c0 = vvFis[i][j] & 1;
+    if(vvFis[i0].empty() || vvFos[i0].size() > 1 || c0 || vFrozen[i0]) {
+      if(Verbose(6))
         cout << "\t\t\t\t\tFanin " << j << " : " << i0 << "(" << c0 << ")" << endl;
-      vvFis[i].push_back(vFisOld[j]);
-      vvCs[i].push_back(vCsOld[j]);
       continue;
     }
     vPfUpdates[i] = vPfUpdates[i] | vPfUpdates[i0];
-    vvFos[i0].erase(find(vvFos[i0].begin(), vvFos[i0].end(), i));
+    LitRef c = vvCs[i].Release(j);
+    RemoveFo(i, j);
+    UpdateCounts(i, vvFis[i][j], -1);
+    vvFis[i].erase(vvFis[i].begin() + j);
+    vvFoIdxs[i].erase(vvFoIdxs[i].begin() + j);
+    vvCs[i].erase(j);
     count++;
-    vector<int>::iterator itfi = vFisOld.begin() + j;
-    vector<lit>::iterator itc = vCsOld.begin() + j;
+    unsigned l = j;
     for(unsigned jj = 0; jj < vvFis[i0].size(); jj++) {
       int f = vvFis[i0][jj];
-      vector<int>::iterator it = find(vvFis[i].begin(), vvFis[i].end(), f);
-      if(it == vvFis[i].end()) {
-        vvFos[f >> 1].push_back(i);
-        itfi = vFisOld.insert(itfi, f);
-        itc = vCsOld.insert(itc, vvCs[i0][jj]);
-        IncRef(*itc);
-        itfi++;
-        itc++;
+      if(find(vvFis[i].begin(), vvFis[i].begin() + j, f) == vvFis[i].begin() + j) {
+        vvFis[i].insert(vvFis[i].begin() + l, f);
+        vvFoIdxs[i].insert(vvFoIdxs[i].begin() + l, 0);
+        vvCs[i].insert(l, vvCs[i0][jj]);
+        UpdateCounts(i, f, 1);
+        AddFo(i, l);
+        l++;
         count--;
       } else {
-        assert(state == PfState::none);
+        assert(state == PfState::none || state == PfState::sim);
       }
     }
+    IndexFis(i, j);
     count += Remove(i0, false);
     vObjs.erase(find(vObjs.begin(), vObjs.end(), i0));
-    vFisOld.erase(itfi);
-    DecRef(*itc);
-    vCsOld.erase(itc);
     j--;
   }
   return count;
 }
 int Transduction::TrivialMerge() {
-  if(nVerbose > 2)
+  if(Verbose(3))
     cout << "\t\tTrivial merge" << endl;
+  TRANSDUCTION_TRACE_SCOPE("TrivialMerge");
+  TRANSDUCTION_PERF_SCOPE("TrivialMerge");
   int count = 0;
   for(list<int>::reverse_iterator it = vObjs.rbegin(); it != vObjs.rend();) {
     count += TrivialMergeOne(*it);
     it++;
   }
+  if(state == PfState::mspf && nMspfWindow)
+    count += Mspf(true);
   return count;
 }
 
-int Transduction::TrivialDecomposeOne(list<int>::iterator const &it, int &pos) {
-  if(nVerbose > 3)
+int Transduction::TrivialDecomposeOne(list<int>::iterator const &it) {
+  if(Verbose(4))
     cout << "\t\t\tTrivial decompose " << *it << endl;
   assert(vvFis[*it].size() > 2);
   int count = 2 - vvFis[*it].size();
   while(vvFis[*it].size() > 2) {
     int f0 = vvFis[*it].back();
-    lit c0 = vvCs[*it].back();
+    LitRef c0 = vvCs[*it].Release(vvCs[*it].size() - 1);
     Disconnect(*it, f0 >> 1, vvFis[*it].size() - 1, false, false);
     int f1 = vvFis[*it].back();
-    lit c1 = vvCs[*it].back();
+    LitRef c1 = vvCs[*it].Release(vvCs[*it].size() - 1);
     Disconnect(*it, f1 >> 1, vvFis[*it].size() - 1, false, false);
-    NewGate(pos);
+    int pos = NewGate();
     Connect(pos, f1, false, false, c1);
     Connect(pos, f0, false, false, c0);
     if(!vPfUpdates[*it]) {
       if(state == PfState::cspf)
-        Update(vGs[pos], vGs[*it]);
+        vGs.Set(pos, vGs[*it]);
       else if(state == PfState::mspf) {
-        lit x = man->Const1();
-        IncRef(x);
+        vector<lit> vLits;
         for(unsigned j = 0; j < vvFis[*it].size(); j++)
-          Update(x, man->And(x, LitFi(*it, j)));
-        Update(vGs[pos], man->Or(man->LitNot(x), vGs[*it]));
-        DecRef(x);
+          vLits.push_back(LitFi(*it, j));
+        LitRef x(man, AndAll(vLits));
+        vGs.Set(pos, man->Or(man->LitNot(x), vGs[*it]));
       }
     }
     Connect(*it, pos << 1, false, false, vGs[pos]);
@@ -99,43 +99,49 @@ int Transduction::TrivialDecomposeOne(list<int>::iterator const &it, int &pos) {
   return count;
 }
 int Transduction::TrivialDecompose() {
-  if(nVerbose > 2)
+  if(Verbose(3))
     cout << "\t\tTrivial decompose" << endl;
+  TRANSDUCTION_TRACE_SCOPE("TrivialDecompose");
+  TRANSDUCTION_PERF_SCOPE("TrivialDecompose");
+  Recycle(true);
   int count = 0;
-  int pos = vPis.size() + 1;
   for(list<int>::iterator it = vObjs.begin(); it != vObjs.end(); it++)
-    if(vvFis[*it].size() > 2)
-      count += TrivialDecomposeOne(it, pos);
+    if(vvFis[*it].size() > 2 && !vFrozen[*it])
+      count += TrivialDecomposeOne(it);
+  if(state == PfState::mspf && nMspfWindow)
+    count += Mspf(true);
   return count;
 }
 
-int Transduction::BalancedDecomposeOne(list<int>::iterator const &it, int &pos) {
-  if(nVerbose > 3)
+int Transduction::BalancedDecomposeOne(list<int>::iterator const &it) {
+  if(Verbose(4))
     cout << "\t\t\tBalanced decompose " << *it << endl;
   assert(fLevel);
   assert(vvFis[*it].size() > 2);
   for(int p = 1; p < (int)vvFis[*it].size(); p++) {
     int f = vvFis[*it][p];
-    lit c = vvCs[*it][p];
     int q = p - 1;
+    unsigned idx = vvFoIdxs[*it][p];
     for(; q >= 0 && vLevels[f >> 1] > vLevels[vvFis[*it][q] >> 1]; q--) {
       vvFis[*it][q + 1] = vvFis[*it][q];
-      vvCs[*it][q + 1] = vvCs[*it][q];
+      vvFoIdxs[*it][q + 1] = vvFoIdxs[*it][q];
     }
     if(q + 1 != p) {
       vvFis[*it][q + 1] = f;
-      vvCs[*it][q + 1] = c;
+      vvCs[*it].Move(p, q + 1);
+      vvFoIdxs[*it][q + 1] = idx;
     }
   }
+  IndexFis(*it, 0);
   int count = 2 - vvFis[*it].size();
   while(vvFis[*it].size() > 2) {
     int f0 = vvFis[*it].back();
-    lit c0 = vvCs[*it].back();
+    LitRef c0 = vvCs[*it].Release(vvCs[*it].size() - 1);
     Disconnect(*it, f0 >> 1, vvFis[*it].size() - 1, false, false);
     int f1 = vvFis[*it].back();
-    lit c1 = vvCs[*it].back();
+    LitRef c1 = vvCs[*it].Release(vvCs[*it].size() - 1);
     Disconnect(*it, f1 >> 1, vvFis[*it].size() - 1, false, false);
-    NewGate(pos);
+    int pos = NewGate();
     Connect(pos, f1, false, false, c1);
     Connect(pos, f0, false, false, c0);
     Connect(*it, pos << 1, false, false);
@@ -143,44 +149,52 @@ int Transduction::BalancedDecomposeOne(list<int>::iterator const &it, int &pos)
     vLevels[pos] = max(vLevels[f0 >> 1], vLevels[f1 >> 1]) + 1;
     vObjs.insert(it, pos);
     int f = vvFis[*it].back();
-    lit c = vvCs[*it].back();
     int q = (int)vvFis[*it].size() - 2;
+    unsigned idx = vvFoIdxs[*it].back();
     for(; q >= 0 && vLevels[f >> 1] > vLevels[vvFis[*it][q] >> 1]; q--) {
       vvFis[*it][q + 1] = vvFis[*it][q];
-      vvCs[*it][q + 1] = vvCs[*it][q];
+      vvFoIdxs[*it][q + 1] = vvFoIdxs[*it][q];
     }
     if(q + 1 != (int)vvFis[*it].size() - 1) {
       vvFis[*it][q + 1] = f;
-      vvCs[*it][q + 1] = c;
+      vvCs[*it].Move(vvFis[*it].size() - 1, q + 1);
+      vvFoIdxs[*it][q + 1] = idx;
     }
+    IndexFis(*it, q + 1);
   }
   vPfUpdates[*it] = true;
   return count;
 }
 
 int Transduction::Decompose() {
-  if(nVerbose)
+  if(Verbose(1))
     cout << "Decompose" << endl;
+  TRANSDUCTION_TRACE_SCOPE("Decompose");
+  TRANSDUCTION_PERF_SCOPE("Decompose");
+  Recycle(true);
   int count = 0;
-  int pos = vPis.size() + 1;
   for(list<int>::iterator it = vObjs.begin(); it != vObjs.end(); it++) {
+    if(vFrozen[*it])
+      continue;
     set<int> s1(vvFis[*it].begin(), vvFis[*it].end());
     assert(s1.size() == vvFis[*it].size());
     list<int>::iterator it2 = it;
     for(it2++; it2 != vObjs.end(); it2++) {
+      if(vFrozen[*it2])
+        continue;
       set<int> s2(vvFis[*it2].begin(), vvFis[*it2].end());
       set<int> s;
       set_intersection(s1.begin(), s1.end(), s2.begin(), s2.end(), inserter(s, s.begin()));
       if(s.size() > 1) {
         if(s == s1) {
           if(s == s2) {
-            if(nVerbose > 1)
+            if(Verbose(2))
               cout << "\tReplace " << *it2 << " by " << *it << endl;
             count += Replace(*it2, *it << 1, false);
             it2 = vObjs.erase(it2);
             it2--;
           } else {
-            if(nVerbose > 1)
+            if(Verbose(2))
               cout << "\tDecompose " << *it2 << " by " << *it << endl;
             for(set<int>::iterator it3 = s.begin(); it3 != s.end(); it3++) {
               unsigned j = find(vvFis[*it2].begin(), vvFis[*it2].end(), *it3) - vvFis[*it2].begin();
@@ -199,10 +213,10 @@ int Transduction::Decompose() {
           it = vObjs.insert(it, *it2);
           vObjs.erase(it2);
         } else {
-          NewGate(pos);
-          if(nVerbose > 1)
+          int pos = NewGate();
+          if(Verbose(2))
             cout << "\tCreate " << pos << " for intersection of " << *it << " and " << *it2  << endl;
-          if(nVerbose > 2) {
+          if(Verbose(3)) {
             cout << "\t\tIntersection :";
             for(set<int>::iterator it3 = s.begin(); it3 != s.end(); it3++)
               cout << " " << (*it3 >> 1) << "(" << (*it3 & 1) << ")";
@@ -220,9 +234,9 @@ int Transduction::Decompose() {
       }
     }
     if(vvFis[*it].size() > 2) {
-      if(nVerbose > 1)
+      if(Verbose(2))
         cout << "\tTrivial decompose " << *it << endl;
-      count += TrivialDecomposeOne(it, pos);
+      count += TrivialDecomposeOne(it);
     }
   }
   return count;
@@ -10,32 +10,57 @@ int Transduction::CountGates() const {
   return vObjs.size();
 }
 int Transduction::CountWires() const {
-  int count = 0;
-  for(std::list<int>::const_iterator it = vObjs.begin(); it != vObjs.end(); it++)
-    count += vvFis[*it].size();
-  return count;
+  return nWires;
 }
 int Transduction::CountNodes() const {
   return CountWires() - CountGates();
 }
 int Transduction::CountLevels() const {
-  int count = 0;
-  for(unsigned i = 0; i < vPos.size(); i++)
-    count = max(count, vLevels[vvFis[vPos[i]][0] >> 1]);
-  return count;
+  return nLevels;
 }
 
-void Transduction::SortObjs_rec(list<int>::iterator const &it) {
-  for(unsigned j = 0; j < vvFis[*it].size(); j++) {
-    int i0 = vvFis[*it][j] >> 1;
+// Wires are counted over gates and levels over po drivers. Every change of
+// a fanin list goes through here, and ComputeLevel recounts the levels.
+void Transduction::UpdateCounts(int i, int f, int d) {
+  Touch(i);
+  if(!vIsPo[i]) {
+    nWires += d;
+    return;
+  }
+  if(!fLevel)
+    return;
+  int level = vLevels[f >> 1];
+  if(d > 0) {
+    if((int)vLevelCounts.size() <= level)
+      vLevelCounts.resize(level + 1);
+    vLevelCounts[level]++;
+    nLevels = max(nLevels, level);
+  } else {
+    vLevelCounts[level]--;
+    while(nLevels && !vLevelCounts[nLevels])
+      nLevels--;
+  }
+}
+
+void Transduction::SortObjs(list<int>::iterator const &it) {
+  vSortStack.clear();
+  vSortStack.push_back(make_pair(it, 0u));
+  while(!vSortStack.empty()) {
+    list<int>::iterator it_i = vSortStack.back().first;
+    unsigned j = vSortStack.back().second++;
+    if(j == vvFis[*it_i].size()) {
+      vSortStack.pop_back();
+      continue;
+    }
+    int i0 = vvFis[*it_i][j] >> 1;
     if(!vvFis[i0].empty()) {
-      list<int>::iterator it_i0 = find(it, vObjs.end(), i0);
+      list<int>::iterator it_i0 = find(it_i, vObjs.end(), i0);
       if(it_i0 != vObjs.end()) {
-        if(nVerbose > 6)
-          cout << "\t\t\t\t\t\tMove " << i0 << " before " << *it << endl;
+        if(Verbose(7))
+          cout << "\t\t\t\t\t\tMove " << i0 << " before " << *it_i << endl;
         vObjs.erase(it_i0);
-        it_i0 = vObjs.insert(it, i0);
-        SortObjs_rec(it_i0);
+        it_i0 = vObjs.insert(it_i, i0);
+        vSortStack.push_back(make_pair(it_i0, 0u));
       }
     }
   }
@@ -43,35 +68,36 @@ void Transduction::SortObjs_rec(list<int>::iterator const &it) {
 
 void Transduction::Connect(int i, int f, bool fSort, bool fUpdate, lit c) {
   int i0 = f >> 1;
-  if(nVerbose > 5)
+  if(Verbose(6))
     cout << "\t\t\t\t\tConnect " << i0 << "(" << (f & 1) << ")" << " to " << i << endl;
   assert(find(vvFis[i].begin(), vvFis[i].end(), f) == vvFis[i].end());
   vvFis[i].push_back(f);
-  vvFos[i0].push_back(i);
+  vvFoIdxs[i].push_back(0);
+  UpdateCounts(i, f, 1);
+  AddFo(i, vvFis[i].size() - 1);
   if(fUpdate)
     vUpdates[i] = true;
-  IncRef(c);
   vvCs[i].push_back(c);
   if(fSort && !vvFos[i].empty() && !vvFis[i0].empty()) {
     list<int>::iterator it = find(vObjs.begin(), vObjs.end(), i);
     list<int>::iterator it_i0 = find(it, vObjs.end(), i0);
     if(it_i0 != vObjs.end()) {
-      if(nVerbose > 6)
+      if(Verbose(7))
         cout << "\t\t\t\t\t\tMove " << i0 << " before " << *it << endl;
       vObjs.erase(it_i0);
       it_i0 = vObjs.insert(it, i0);
-      SortObjs_rec(it_i0);
+      SortObjs(it_i0);
     }
   }
 }
 
 void Transduction::Disconnect(int i, int i0, unsigned j, bool fUpdate, bool fPfUpdate) {
-  if(nVerbose > 5)
+  if(Verbose(6))
     cout << "\t\t\t\t\tDisconnect " << i0 << "(" << (vvFis[i][j] & 1) << ")" << " from " << i << endl;
-  vvFos[i0].erase(find(vvFos[i0].begin(), vvFos[i0].end(), i));
-  vvFis[i].erase(vvFis[i].begin() + j);
-  DecRef(vvCs[i][j]);
-  vvCs[i].erase(vvCs[i].begin() + j);
+  RemoveFo(i, j);
+  UpdateCounts(i, vvFis[i][j], -1);
+  EraseFi(i, j);
+  vvCs[i].erase(j);
   if(fUpdate)
     vUpdates[i] = true;
   if(fPfUpdate)
@@ -79,154 +105,337 @@ void Transduction::Disconnect(int i, int i0, unsigned j, bool fUpdate, bool fPfU
 }
 
 int Transduction::Remove(int i, bool fPfUpdate) {
-  if(nVerbose > 4)
+  if(Verbose(5))
     cout << "\t\t\t\tRemove " << i << endl;
   assert(vvFos[i].empty());
   for(unsigned j = 0; j < vvFis[i].size(); j++) {
     int i0 = vvFis[i][j] >> 1;
-    vvFos[i0].erase(find(vvFos[i0].begin(), vvFos[i0].end(), i));
+    RemoveFo(i, j);
+    UpdateCounts(i, vvFis[i][j], -1);
     if(fPfUpdate)
       vPfUpdates[i0] = true;
   }
   int count = vvFis[i].size();
   vvFis[i].clear();
-  DecRef(vFs[i]);
-  DecRef(vGs[i]);
-  vFs[i] = vGs[i] = LitMax();
-  DelVec(vvCs[i]);
+  vvFoIdxs[i].clear();
+  vFs.Set(i, LitMax());
+  vGs.Set(i, LitMax());
+  vvCs[i].clear();
   vUpdates[i] = vPfUpdates[i] = false;
+  vFrozen[i] = false;
   return count;
 }
 
-int Transduction::FindFi(int i, int i0) const {
-  for(unsigned j = 0; j < vvFis[i].size(); j++)
-    if((vvFis[i][j] >> 1) == i0)
-      return j;
-  return -1;
+// Edges are indexed from both ends: vvFiIdxs[i0][j] is the position of i0
+// among the fanins of its j-th fanout, and vvFoIdxs[i][l] is the position
+// of i among the fanouts of its l-th fanin. Fanouts are unordered and
+// removed by swapping with the last one, while fanins keep their order.
+void Transduction::AddFo(int i, unsigned l) {
+  int i0 = vvFis[i][l] >> 1;
+  Touch(i0);
+  vvFoIdxs[i][l] = vvFos[i0].size();
+  vvFos[i0].push_back(i);
+  vvFiIdxs[i0].push_back(l);
+}
+void Transduction::RemoveFo(int i, unsigned l) {
+  int i0 = vvFis[i][l] >> 1;
+  Touch(i0);
+  unsigned j = vvFoIdxs[i][l];
+  int k = vvFos[i0].back();
+  unsigned kl = vvFiIdxs[i0].back();
+  vvFos[i0][j] = k;
+  vvFiIdxs[i0][j] = kl;
+  vvFoIdxs[k][kl] = j;
+  vvFos[i0].pop_back();
+  vvFiIdxs[i0].pop_back();
+}
+void Transduction::EraseFi(int i, unsigned l) {
+  vvFis[i].erase(vvFis[i].begin() + l);
+  vvFoIdxs[i].erase(vvFoIdxs[i].begin() + l);
+  IndexFis(i, l);
+}
+void Transduction::IndexFis(int i, unsigned l) {
+  for(; l < vvFis[i].size(); l++)
+    vvFiIdxs[vvFis[i][l] >> 1][vvFoIdxs[i][l]] = l;
 }
 int Transduction::Replace(int i, int f, bool fUpdate) {
-  if(nVerbose > 4)
+  if(Verbose(5))
     cout << "\t\t\t\tReplace " << i << " by " << (f >> 1) << "(" << (f & 1) << ")" << endl;
   assert(i != (f >> 1));
   int count = 0;
   for(unsigned j = 0; j < vvFos[i].size(); j++) {
     int k = vvFos[i][j];
-    int l = FindFi(k, i);
-    assert(l >= 0);
+    int l = FindFi(i, j);
     int fc = f ^ (vvFis[k][l] & 1);
+    UpdateCounts(k, vvFis[k][l], -1);
     if(find(vvFis[k].begin(), vvFis[k].end(), fc) != vvFis[k].end()) {
-      DecRef(vvCs[k][l]);
-      vvCs[k].erase(vvCs[k].begin() + l);
-      vvFis[k].erase(vvFis[k].begin() + l);
+      vvCs[k].erase(l);
+      EraseFi(k, l);
       count++;
     } else {
       vvFis[k][l] = f ^ (vvFis[k][l] & 1);
-      vvFos[f >> 1].push_back(k);
+      UpdateCounts(k, vvFis[k][l], 1);
+      AddFo(k, l);
     }
     if(fUpdate)
       vUpdates[k] = true;
   }
   vvFos[i].clear();
+  vvFiIdxs[i].clear();
   vPfUpdates[f >> 1] = true;
   return count + Remove(i);
 }
 int Transduction::ReplaceByConst(int i, bool c) {
-  if(nVerbose > 4)
+  // each frame is (node, constant, next fanout, count so far)
+  vector<pair<pair<int, bool>, pair<unsigned, int> > > vFrames;
+  vFrames.push_back(make_pair(make_pair(i, c), make_pair(0u, 0)));
+  if(Verbose(5))
     std::cout << "\t\t\t\tReplace " << i << " by " << c << std::endl;
-  int count = 0;
-  for(unsigned j = 0; j < vvFos[i].size(); j++) {
+  while(true) {
+    i = vFrames.back().first.first;
+    c = vFrames.back().first.second;
+    unsigned j = vFrames.back().second.first++;
+    int &count = vFrames.back().second.second;
+    if(j == vvFos[i].size()) {
+      count += vvFos[i].size();
+      vvFos[i].clear();
+      vvFiIdxs[i].clear();
+      count += Remove(i);
+      int r = count;
+      vFrames.pop_back();
+      if(vFrames.empty())
+        return r;
+      vFrames.back().second.second += r;
+      continue;
+    }
     int k = vvFos[i][j];
-    int l = FindFi(k, i);
-    assert(l >= 0);
+    int l = FindFi(i, j);
     bool fc = c ^ (vvFis[k][l] & 1);
-    DecRef(vvCs[k][l]);
-    vvCs[k].erase(vvCs[k].begin() + l);
-    vvFis[k].erase(vvFis[k].begin() + l);
+    UpdateCounts(k, vvFis[k][l], -1);
+    vvCs[k].erase(l);
+    EraseFi(k, l);
     if(fc) {
       if(vvFis[k].size() == 1)
         count += Replace(k, vvFis[k][0]);
       else
         vUpdates[k] = true;
-    } else
-      count += ReplaceByConst(k, 0);
+    } else {
+      if(Verbose(5))
+        std::cout << "\t\t\t\tReplace " << k << " by " << 0 << std::endl;
+      vFrames.push_back(make_pair(make_pair(k, false), make_pair(0u, 0)));
+    }
   }
-  count += vvFos[i].size();
-  vvFos[i].clear();
-  return count + Remove(i);
 }
 
-void Transduction::NewGate(int &pos) {
-  while(pos != nObjsAlloc && (!vvFis[pos].empty() || !vvFos[pos].empty()))
-    pos++;
-  if(nVerbose > 4)
-    std::cout << "\t\t\t\tCreate " << pos << std::endl;
-  if(pos == nObjsAlloc) {
-    nObjsAlloc++;
-    vvFis.resize(nObjsAlloc);
-    vvFos.resize(nObjsAlloc);
-    if(fLevel) {
-      vLevels.resize(nObjsAlloc);
-      vSlacks.resize(nObjsAlloc);
-      vvFiSlacks.resize(nObjsAlloc);
-    }
-    vFs.resize(nObjsAlloc, LitMax());
-    vGs.resize(nObjsAlloc, LitMax());
-    vvCs.resize(nObjsAlloc);
-    vUpdates.resize(nObjsAlloc);
-    vPfUpdates.resize(nObjsAlloc);
+int Transduction::NewGate() {
+  if(vFrees.empty()) {
+    int n = nObjsAlloc;
+    nObjsAlloc += nObjsAlloc / 2 + 1;
+    Allocate();
+    for(int i = nObjsAlloc - 1; i >= n; i--)
+      vFrees.push_back(i);
   }
+  int pos = vFrees.back();
+  vFrees.pop_back();
+  vHists[pos] = 0;
+  vGEpochs[pos] = -1;
+  assert(vvFis[pos].empty() && vvFos[pos].empty());
+  if(Verbose(5))
+    std::cout << "\t\t\t\tCreate " << pos << std::endl;
+  return pos;
 }
 
-void Transduction::MarkFiCone_rec(vector<bool> &vMarks, int i) const {
-  if(vMarks[i])
-    return;
-  vMarks[i] = true;
-  for(unsigned j = 0; j < vvFis[i].size(); j++)
-    MarkFiCone_rec(vMarks, vvFis[i][j] >> 1);
-}
-void Transduction::MarkFoCone_rec(vector<bool> &vMarks, int i) const {
-  if(vMarks[i])
+// Removed nodes may stay in vObjs until the next sweep, so their ids are
+// made available only here, at the start of a pass, after dropping them.
+void Transduction::Recycle(bool fCompact) {
+  TRANSDUCTION_TRACE_SCOPE("Recycle");
+  TRANSDUCTION_PERF_SCOPE("Recycle");
+  for(list<int>::iterator it = vObjs.begin(); it != vObjs.end();) {
+    if(vvFis[*it].empty() && vvFos[*it].empty()) {
+      it = vObjs.erase(it);
+      continue;
+    }
+    it++;
+  }
+  int nLives = vPis.size() + 1 + vObjs.size() + vPos.size();
+  if(fCompact && nLives * 2 < nObjsAlloc) {
+    Compact();
     return;
-  vMarks[i] = true;
-  for(unsigned j = 0; j < vvFos[i].size(); j++)
-    MarkFoCone_rec(vMarks, vvFos[i][j]);
+  }
+  NewTravId();
+  for(list<int>::iterator it = vObjs.begin(); it != vObjs.end(); it++)
+    vTravIds[*it] = nTravIds;
+  for(unsigned i = 0; i < vPos.size(); i++)
+    vTravIds[vPos[i]] = nTravIds;
+  vFrees.clear();
+  for(int i = nObjsAlloc - 1; i > (int)vPis.size(); i--)
+    if(!IsTravIdCurrent(i))
+      vFrees.push_back(i);
 }
 
-bool Transduction::IsFoConeShared_rec(vector<int> &vVisits, int i, int visitor) const {
-  if(vVisits[i] == visitor)
-    return false;
-  if(vVisits[i])
-    return true;
-  vVisits[i] = visitor;
-  for(unsigned j = 0; j < vvFos[i].size(); j++)
-    if(IsFoConeShared_rec(vVisits, vvFos[i][j], visitor))
-      return true;
-  return false;
-}
-bool Transduction::IsFoConeShared(int i) const {
-  vector<int> vVisits(nObjsAlloc);
-  for(unsigned j = 0; j < vvFos[i].size(); j++)
-    if(IsFoConeShared_rec(vVisits, vvFos[i][j], j + 1))
-      return true;
-  return false;
+template <typename T>
+static void Remap(vector<T> &v, vector<int> const &vMap, int n) {
+  vector<T> v2(n);
+  for(unsigned i = 0; i < v.size(); i++)
+    if(vMap[i] != -1)
+      v2[vMap[i]] = std::move(v[i]);
+  v.swap(v2);
 }
 
-void Transduction::ImportAig(aigman const &aig) {
-  if(nVerbose > 2)
-    cout << "\t\tImport aig" << endl;
-  nObjsAlloc = aig.nObjs + aig.nPos;
+// Renumber the nodes densely in topological order: constant, pis, gates
+// in the order of vObjs, and then pos.
+void Transduction::Compact() {
+  TRANSDUCTION_TRACE_SCOPE("Compact");
+  TRANSDUCTION_PERF_SCOPE("Compact");
+  if(Verbose(2))
+    cout << "\tCompact " << nObjsAlloc << " -> " << vPis.size() + 1 + vObjs.size() + vPos.size() << endl;
+  vector<int> vMap(nObjsAlloc, -1);
+  int n = 0;
+  for(; n <= (int)vPis.size(); n++)
+    vMap[n] = n;
+  for(list<int>::iterator it = vObjs.begin(); it != vObjs.end(); it++)
+    vMap[*it] = n++;
+  for(unsigned i = 0; i < vPos.size(); i++)
+    vMap[vPos[i]] = n++;
+  for(int i = 0; i < nObjsAlloc; i++)
+    if(vMap[i] != -1) {
+      for(unsigned j = 0; j < vvFis[i].size(); j++)
+        vvFis[i][j] = (vMap[vvFis[i][j] >> 1] << 1) ^ (vvFis[i][j] & 1);
+      for(unsigned j = 0; j < vvFos[i].size(); j++)
+        vvFos[i][j] = vMap[vvFos[i][j]];
+    }
+  Remap(vvFis, vMap, n);
+  Remap(vvFos, vMap, n);
+  Remap(vvFiIdxs, vMap, n);
+  Remap(vvFoIdxs, vMap, n);
+  if(fLevel) {
+    Remap(vLevels, vMap, n);
+    Remap(vSlacks, vMap, n);
+    Remap(vvFiSlacks, vMap, n);
+  }
+  vFs.Remap(vMap, n);
+  vGs.Remap(vMap, n);
+  Remap(vvCs, vMap, n);
+  Remap(vUpdates, vMap, n);
+  Remap(vPfUpdates, vMap, n);
+  Remap(vFoConeShared, vMap, n);
+  Remap(vFrozen, vMap, n);
+  Remap(vIsPo, vMap, n);
+  Remap(vHists, vMap, n);
+  nIdSpace = ++nIdSpaces;
+  Remap(vModEpochs, vMap, n);
+  Remap(vGEpochs, vMap, n);
+  for(list<int>::iterator it = vObjs.begin(); it != vObjs.end(); it++)
+    *it = vMap[*it];
+  for(unsigned i = 0; i < vPos.size(); i++)
+    vPos[i] = vMap[vPos[i]];
+  nObjsAlloc = n;
+  vFrees.clear();
+  vCostFs.clear();
+  vCostFs.resize(nObjsAlloc);
+  vCosts.assign(nObjsAlloc * 2, -1);
+  vTravIds.assign(nObjsAlloc, 0);
+  nTravIds = 0;
+  vVisits.assign(nObjsAlloc, 0);
+  nVisits = 0;
+}
+void Transduction::Allocate() {
   vvFis.resize(nObjsAlloc);
   vvFos.resize(nObjsAlloc);
+  vvFiIdxs.resize(nObjsAlloc);
+  vvFoIdxs.resize(nObjsAlloc);
   if(fLevel) {
     vLevels.resize(nObjsAlloc);
     vSlacks.resize(nObjsAlloc);
     vvFiSlacks.resize(nObjsAlloc);
   }
-  vFs.resize(nObjsAlloc, LitMax());
-  vGs.resize(nObjsAlloc, LitMax());
-  vvCs.resize(nObjsAlloc);
+  vFs.resize(nObjsAlloc);
+  vGs.resize(nObjsAlloc);
+  while((int)vvCs.size() < nObjsAlloc)
+    vvCs.emplace_back(man);
   vUpdates.resize(nObjsAlloc);
   vPfUpdates.resize(nObjsAlloc);
+  vFrozen.resize(nObjsAlloc);
+  vIsPo.resize(nObjsAlloc);
+  vHists.resize(nObjsAlloc);
+  vModEpochs.resize(nObjsAlloc);
+  vGEpochs.resize(nObjsAlloc, -1);
+  if((int)vCostFs.size() < nObjsAlloc) {
+    vCostFs.resize(nObjsAlloc);
+    vCosts.resize(nObjsAlloc * 2, -1);
+  }
+  vTravIds.resize(nObjsAlloc);
+  vVisits.resize(nObjsAlloc);
+}
+
+void Transduction::NewTravId() {
+  if(++nTravIds == 0) {
+    fill(vTravIds.begin(), vTravIds.end(), 0);
+    nTravIds = 1;
+  }
+}
+void Transduction::MarkFiCone(int i) {
+  vStack.clear();
+  vStack.push_back(i);
+  while(!vStack.empty()) {
+    i = vStack.back();
+    vStack.pop_back();
+    if(vTravIds[i] == nTravIds)
+      continue;
+    vTravIds[i] = nTravIds;
+    for(unsigned j = 0; j < vvFis[i].size(); j++)
+      vStack.push_back(vvFis[i][j] >> 1);
+  }
+}
+void Transduction::MarkFoCone(int i) {
+  vStack.clear();
+  vStack.push_back(i);
+  while(!vStack.empty()) {
+    i = vStack.back();
+    vStack.pop_back();
+    if(vTravIds[i] == nTravIds)
+      continue;
+    vTravIds[i] = nTravIds;
+    for(unsigned j = 0; j < vvFos[i].size(); j++)
+      vStack.push_back(vvFos[i][j]);
+  }
+}
+
+// The fanout cone of each fanout is stamped with its own visit id, all
+// larger than the base, so meeting a larger foreign id means sharing.
+bool Transduction::IsFoConeShared(int i) {
+  unsigned base = nVisits;
+  nVisits += vvFos[i].size() + 1;
+  if(nVisits < base) {
+    fill(vVisits.begin(), vVisits.end(), 0);
+    base = 0;
+    nVisits = vvFos[i].size() + 1;
+  }
+  for(unsigned j = 0; j < vvFos[i].size(); j++) {
+    unsigned visitor = base + j + 1;
+    vStack.clear();
+    vStack.push_back(vvFos[i][j]);
+    while(!vStack.empty()) {
+      int k = vStack.back();
+      vStack.pop_back();
+      if(vVisits[k] == visitor)
+        continue;
+      if(vVisits[k] > base)
+        return true;
+      vVisits[k] = visitor;
+      for(unsigned jj = 0; jj < vvFos[k].size(); jj++)
+        vStack.push_back(vvFos[k][jj]);
+    }
+  }
+  return false;
+}
+
+void Transduction::ImportAig(aigman const &aig) {
+  if(Verbose(3))
+    cout << "\t\tImport aig" << endl;
+  TRANSDUCTION_PERF_SCOPE("ImportAig");
+  nObjsAlloc = aig.nObjs + aig.nPos;
+  Allocate();
   vector<int> v(aig.nObjs, -1);
   v[0] = 0;
   for(int i = 0; i < aig.nPis; i++) {
@@ -234,7 +443,7 @@ void Transduction::ImportAig(aigman const &aig) {
     v[i + 1] = (i + 1) << 1;
   }
   for(int i = aig.nPis + 1; i < aig.nObjs; i++) {
-    if(nVerbose > 3)
+    if(Verbose(4))
       cout << "\t\t\tImport node " << i << endl;
     if(aig.vObjs[i + i] == aig.vObjs[i + i + 1])
       v[i] = v[aig.vObjs[i + i] >> 1] ^ (aig.vObjs[i + i] & 1);
@@ -246,21 +455,33 @@ void Transduction::ImportAig(aigman const &aig) {
     }
   }
   for(int i = 0; i < aig.nPos; i++) {
-    if(nVerbose > 3)
+    if(Verbose(4))
       cout << "\t\t\tImport po " << i << endl;
     vPos.push_back(i + aig.nObjs);
+    vIsPo[vPos[i]] = true;
     Connect(vPos[i], v[aig.vPos[i] >> 1] ^ (aig.vPos[i] & 1));
   }
 }
 
+// Gates left out of an eco region are placed first, and the pseudo pis
+// standing for them are connected to their outputs.
 void Transduction::GenerateAig(aigman &aig) const {
+  int nPisOrig = vPis.size() - aigFixed.nPos;
   aig.clear();
-  aig.nPis = vPis.size();
-  aig.nObjs = aig.nPis + 1;
-  aig.vObjs.resize(aig.nObjs * 2);
+  if(aigFixed.nPos) {
+    aig = aigFixed;
+    aig.vPos.clear();
+    aig.nPos = 0;
+  } else {
+    aig.nPis = nPisOrig;
+    aig.nObjs = aig.nPis + 1;
+    aig.vObjs.resize(aig.nObjs * 2);
+  }
   vector<int> values(nObjsAlloc);
-  for(int i = 0; i < aig.nPis; i++)
+  for(int i = 0; i < nPisOrig; i++)
     values[i + 1] = (i + 1) << 1;
+  for(int k = 0; k < aigFixed.nPos; k++)
+    values[nPisOrig + 1 + k] = aigFixed.vPos[k];
   for(list<int>::const_iterator it = vObjs.begin(); it != vObjs.end(); it++) {
     assert(vvFis[*it].size() > 1);
     int i0 = vvFis[*it][0] >> 1;
@@ -297,6 +518,17 @@ void Transduction::ComputeLevel() {
         vLevels[*it] = (int)lev.size();
     }
   }
+  // Counted here rather than through UpdateCounts, which would touch the
+  // pos and make Mspf recompute every shared cone on the next sweep.
+  vLevelCounts.clear();
+  nLevels = 0;
+  for(unsigned i = 0; i < vPos.size(); i++) {
+    int level = vLevels[vvFis[vPos[i]][0] >> 1];
+    if((int)vLevelCounts.size() <= level)
+      vLevelCounts.resize(level + 1);
+    vLevelCounts[level]++;
+    nLevels = max(nLevels, level);
+  }
   if(nMaxLevels == -1)
     nMaxLevels = CountLevels();
   for(unsigned i = 0; i < vPos.size(); i++) {
@@ -307,8 +539,7 @@ void Transduction::ComputeLevel() {
     vSlacks[*it] = nMaxLevels;
     for(unsigned j = 0; j < vvFos[*it].size(); j++) {
       int k = vvFos[*it][j];
-      int l = FindFi(k, *it);
-      assert(l >= 0);
+      int l = FindFi(*it, j);
       vSlacks[*it] = min(vSlacks[*it], vvFiSlacks[k][l]);
     }
     vvFiSlacks[*it].resize(vvFis[*it].size());
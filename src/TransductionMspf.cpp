@@ -1,74 +1,99 @@
 #include <iostream>
+#include <algorithm>
 #include <cassert>
 
 #include "Transduction.h"
 
 using namespace std;
 
-void Transduction::BuildFoConeCompl(int i, vector<lit> &vPoFsCompl) const {
-  if(nVerbose > 3)
+// Only the pos whose functions change are computed and listed in vReachedPos.
+// Any other po is equivalent to vPoFs under its care set and would not
+// restrict the permissible function. With a window, gates more than
+// nMspfWindow levels away from i are not built, and the differences of the
+// changed gates on the boundary are returned in vBoundDiffs so that they can
+// be treated as fully observable. The result then depends on the structure
+// around i, so the passes that merge or decompose gates without recomputing
+// the permissible functions run Mspf again at the end.
+void Transduction::BuildFoConeCompl(int i, LitVec &vPoFsCompl, vector<int> &vReachedPos, LitVec &vBoundDiffs) const {
+  if(Verbose(4))
     cout << "\t\t\tBuild with complemented " << i << endl;
-  vector<lit> vFsCompl;
-  CopyVec(vFsCompl, vFs);
-  vFsCompl[i] = man->LitNot(vFs[i]);
-  vector<bool> vUpdatesCompl(nObjsAlloc);
+  LitVec vFsCompl(man, nObjsAlloc);
+  vFsCompl.Set(i, man->LitNot(vFs[i]));
+  vector<int> vDepthsCompl(nObjsAlloc);
   for(unsigned j = 0; j < vvFos[i].size(); j++)
-    vUpdatesCompl[vvFos[i][j]] = true;
+    vDepthsCompl[vvFos[i][j]] = 1;
   for(list<int>::const_iterator it = vObjs.begin(); it != vObjs.end(); it++)
-    if(vUpdatesCompl[*it]) {
+    if(vDepthsCompl[*it]) {
       Build(*it, vFsCompl);
-      if(vFsCompl[*it] != vFs[*it])
-        for(unsigned j = 0; j < vvFos[*it].size(); j++)
-          vUpdatesCompl[vvFos[*it][j]] = true;
+      if(vFsCompl[*it] == vFs[*it])
+        continue;
+      bool fBound = false;
+      for(unsigned j = 0; j < vvFos[*it].size(); j++) {
+        int k = vvFos[*it][j];
+        if(nMspfWindow && !vIsPo[k] && vDepthsCompl[*it] >= nMspfWindow) {
+          fBound |= !vDepthsCompl[k];
+          continue;
+        }
+        if(!vDepthsCompl[k] || vDepthsCompl[k] > vDepthsCompl[*it] + 1)
+          vDepthsCompl[k] = vDepthsCompl[*it] + 1;
+      }
+      if(fBound)
+        vBoundDiffs.push_back(Xor(vFs[*it], vFsCompl[*it]));
     }
+  vReachedPos.clear();
   for(unsigned j = 0; j < vPos.size(); j++)
-    Update(vPoFsCompl[j], LitFi(vPos[j], 0, vFsCompl));
-  DelVec(vFsCompl);
+    if(vDepthsCompl[vPos[j]]) {
+      vPoFsCompl.Set(j, LitFi(vPos[j], 0, vFsCompl));
+      vReachedPos.push_back(j);
+    }
 }
 bool Transduction::MspfCalcG(int i) {
-  lit g = vGs[i];
-  IncRef(g);
-  vector<lit> vPoFsCompl(vPos.size(), LitMax());
-  BuildFoConeCompl(i, vPoFsCompl);
-  Update(vGs[i], man->Const1());
-  for(unsigned j = 0; j < vPos.size(); j++) {
-    lit x = man->LitNot(Xor(vPoFs[j], vPoFsCompl[j]));
-    IncRef(x);
-    Update(x, man->Or(x, vvCs[vPos[j]][0]));
-    Update(vGs[i], man->And(vGs[i], x));
-    DecRef(x);
+  LitVec vPoFsCompl(man, vPos.size());
+  vector<int> vReachedPos;
+  LitVec vBoundDiffs(man);
+  BuildFoConeCompl(i, vPoFsCompl, vReachedPos, vBoundDiffs);
+  LitVec vCares(man);
+  for(unsigned k = 0; k < vReachedPos.size(); k++) {
+    int j = vReachedPos[k];
+    LitRef x(man, man->LitNot(Xor(vPoFs[j], vPoFsCompl[j])));
+    vCares.push_back(man->Or(x, vvCs[vPos[j]][0]));
   }
-  DelVec(vPoFsCompl);
-  DecRef(g);
-  return vGs[i] != g;
+  vector<lit> vLits(vCares.begin(), vCares.end());
+  for(unsigned k = 0; k < vBoundDiffs.size(); k++)
+    vLits.push_back(man->LitNot(vBoundDiffs[k]));
+  LitRef g(man, AndAll(vLits));
+  if(g == vGs[i])
+    return false;
+  vGs.Set(i, std::move(g));
+  return true;
 }
 
 int Transduction::MspfCalcC(int i, int block_i0) {
   for(unsigned j = 0; j < vvFis[i].size(); j++) {
-    lit x = man->Const1();
-    IncRef(x);
+    vector<lit> vLits;
     for(unsigned jj = 0; jj < vvFis[i].size(); jj++)
       if(j != jj)
-        Update(x, man->And(x, LitFi(i, jj)));
-    Update(x, man->Or(man->LitNot(x), vGs[i]));
+        vLits.push_back(LitFi(i, jj));
+    LitRef x(man, AndAll(vLits));
+    x = man->Or(man->LitNot(x), vGs[i]);
     int i0 = vvFis[i][j] >> 1;
-    if(i0 != block_i0 && man->IsConst1(man->Or(x, LitFi(i, j)))) {
-      if(nVerbose > 4)
+    if(i0 != block_i0 && Implies(man->LitNot(x), LitFi(i, j))) {
+      if(Verbose(5))
         cout << "\t\t\t\tMspf remove wire " << i0 << "(" << (vvFis[i][j] & 1) << ")" << " -> " << i << endl;
       Disconnect(i, i0, j);
-      DecRef(x);
       return RemoveRedundantFis(i, block_i0, j) + 1;
     } else if(vvCs[i][j] != x) {
-      Update(vvCs[i][j], x);
+      vvCs[i].Set(j, std::move(x));
       vPfUpdates[i0] = true;
     }
-    DecRef(x);
   }
   return 0;
 }
 
 int Transduction::Mspf(bool fSort, int block, int block_i0) {
-  if(nVerbose > 2) {
+  TRANSDUCTION_TRACE_SCOPE_ARG("Mspf", block);
+  TRANSDUCTION_PERF_SCOPE("Mspf");
+  if(Verbose(3)) {
     cout << "\t\tMspf";
     if(block_i0 != -1)
       cout << " (block " << block_i0 << " -> " << block << ")";
@@ -78,32 +103,46 @@ int Transduction::Mspf(bool fSort, int block, int block_i0) {
   }
   assert(AllFalse(vUpdates));
   vFoConeShared.resize(nObjsAlloc);
+  vConeEpochs.resize(nObjsAlloc);
   if(state != PfState::mspf)
     for(list<int>::iterator it = vObjs.begin(); it != vObjs.end(); it++)
       vPfUpdates[*it] = true;
   state = PfState::mspf;
+  if(fSort)
+    RankObjs();
   int count = 0;
   for(list<int>::reverse_iterator it = vObjs.rbegin(); it != vObjs.rend();) {
     if(vvFos[*it].empty()) {
-      if(nVerbose > 3)
+      if(Verbose(4))
         cout << "\t\t\tRemove unused " << *it << endl;
       count += Remove(*it);
       it = list<int>::reverse_iterator(vObjs.erase(--(it.base())));
       continue;
     }
-    if(!vFoConeShared[*it] && !vPfUpdates[*it] && (vvFos[*it].size() == 1 || !IsFoConeShared(*it))) {
+    long long e = vModEpochs[*it];
+    for(unsigned j = 0; j < vvFos[*it].size(); j++) {
+      int k = vvFos[*it][j];
+      e = max(e, vIsPo[k]? vModEpochs[k]: vConeEpochs[k]);
+    }
+    vConeEpochs[*it] = e;
+    if(vFrozen[*it] || (!vFoConeShared[*it] && !vPfUpdates[*it] && (vvFos[*it].size() == 1 || !IsFoConeShared(*it)))) {
+      vPfUpdates[*it] = false;
       it++;
       continue;
     }
-    if(nVerbose > 3)
+    if(vFoConeShared[*it] && !vPfUpdates[*it] && vGEpochs[*it] >= e) {
+      if(Verbose(4))
+        cout << "\t\t\tMspf " << *it << " unchanged" << endl;
+      it++;
+      continue;
+    }
+    if(Verbose(4))
       cout << "\t\t\tMspf " << *it << endl;
     if(vvFos[*it].size() == 1 || !IsFoConeShared(*it)) {
       if(vFoConeShared[*it]) {
         vFoConeShared[*it] = false;
-        lit g = vGs[*it];
-        IncRef(g);
+        LitRef g = vGs.Release(*it);
         CalcG(*it);
-        DecRef(g);
         if(g == vGs[*it] && !vPfUpdates[*it]) {
           it++;
           continue;
@@ -112,12 +151,14 @@ int Transduction::Mspf(bool fSort, int block, int block_i0) {
         CalcG(*it);
     } else {
       vFoConeShared[*it] = true;
-      if(!MspfCalcG(*it) && !vPfUpdates[*it]) {
+      bool fChanged = MspfCalcG(*it);
+      vGEpochs[*it] = nEpoch;
+      if(!fChanged && !vPfUpdates[*it]) {
         it++;
         continue;
       }
-      bool IsConst1 = man->IsConst1(man->Or(vGs[*it], vFs[*it]));
-      bool IsConst0 = IsConst1? false: man->IsConst1(man->Or(vGs[*it], man->LitNot(vFs[*it])));
+      bool IsConst1 = Implies(man->LitNot(vGs[*it]), vFs[*it]);
+      bool IsConst0 = IsConst1? false: IsDisjoint(man->LitNot(vGs[*it]), vFs[*it]);
       if(IsConst1 || IsConst0) {
         count += ReplaceByConst(*it, (int)IsConst1);
         vObjs.erase(--(it.base()));
@@ -149,15 +190,26 @@ int Transduction::Mspf(bool fSort, int block, int block_i0) {
   return count;
 }
 
+void Transduction::SetMspfWindow(int nWindow) {
+  nMspfWindow = nWindow;
+  if(state == PfState::mspf)
+    state = PfState::none;
+}
+
 bool Transduction::MspfDebug() {
-  vector<lit> vGsOld;
-  CopyVec(vGsOld, vGs);
-  vector<vector<lit> > vvCsOld;
-  CopyVec(vvCsOld, vvCs);
+  LitVec vGsOld;
+  vGsOld.Assign(vGs);
+  vector<LitVec> vvCsOld;
+  LitVec::Assign(vvCsOld, vvCs);
   state = PfState::none;
   Mspf();
-  bool r = vGsOld == vGs && vvCsOld == vvCs;
-  DelVec(vGsOld);
-  DelVec(vvCsOld);
-  return r;
+  return vGsOld == vGs && vvCsOld == vvCs;
+}
+
+// Once Mspf has converged, another sweep should remove nothing and skip
+// every node whose fanout cone is shared.
+bool Transduction::MspfSkipDebug() {
+  vector<long long> vGEpochsOld = vGEpochs;
+  int count = Mspf();
+  return !count && vGEpochsOld == vGEpochs;
 }
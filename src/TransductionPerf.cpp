@@ -0,0 +1,154 @@
+#include <iomanip>
+#include <algorithm>
+#include <map>
+#include <string>
+
+#ifdef __linux__
+#include <cstring>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+#include "TransductionPerf.h"
+
+using namespace std;
+
+atomic<bool> TransductionPerf::fEnabled(false);
+mutex TransductionPerf::mtx;
+vector<TransductionPerf::Site *> TransductionPerf::vSites;
+
+namespace {
+
+// Counters of the calling thread, opened on first use and closed when the
+// thread exits. A counter that cannot be opened stays -1.
+struct Counters {
+  bool fOpened = false;
+  int fds[TransductionPerf::nCounters];
+  Counters() {
+    for(int k = 0; k < TransductionPerf::nCounters; k++)
+      fds[k] = -1;
+  }
+  ~Counters() {
+#ifdef __linux__
+    for(int k = 0; k < TransductionPerf::nCounters; k++)
+      if(fds[k] != -1)
+        close(fds[k]);
+#endif
+  }
+  bool Open() {
+    fOpened = true;
+    bool fAny = false;
+#ifdef __linux__
+    static unsigned long long const configs[TransductionPerf::nCounters] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES};
+    for(int k = 0; k < TransductionPerf::nCounters; k++) {
+      perf_event_attr attr;
+      memset(&attr, 0, sizeof(attr));
+      attr.size = sizeof(attr);
+      attr.type = PERF_TYPE_HARDWARE;
+      attr.config = configs[k];
+      attr.exclude_kernel = 1;
+      attr.exclude_hv = 1;
+      fds[k] = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+      fAny |= fds[k] != -1;
+    }
+#endif
+    return fAny;
+  }
+  void Read(long long *vCounts) const {
+    for(int k = 0; k < TransductionPerf::nCounters; k++) {
+      vCounts[k] = -1;
+#ifdef __linux__
+      long long v;
+      if(fds[k] != -1 && read(fds[k], &v, sizeof(v)) == sizeof(v))
+        vCounts[k] = v;
+#endif
+    }
+  }
+};
+
+thread_local Counters counters;
+
+}
+
+TransductionPerf::Site::Site(char const *name): name(name), nCalls(0), seconds(0) {
+  for(int k = 0; k < nCounters; k++)
+    vCounts[k] = 0;
+  lock_guard<mutex> lock(mtx);
+  vSites.push_back(this);
+}
+
+bool TransductionPerf::Enable() {
+  if(!counters.fOpened && !counters.Open())
+    return false;
+  fEnabled = true;
+  return true;
+}
+
+void TransductionPerf::Disable() {
+  fEnabled = false;
+}
+
+void TransductionPerf::Start(long long *vCounts, chrono::steady_clock::time_point &start) {
+  if(!counters.fOpened)
+    counters.Open();
+  counters.Read(vCounts);
+  start = chrono::steady_clock::now();
+}
+
+void TransductionPerf::Stop(Site &site, long long const *vCounts, chrono::steady_clock::time_point start) {
+  long long vEnds[nCounters];
+  counters.Read(vEnds);
+  double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+  lock_guard<mutex> lock(mtx);
+  site.nCalls++;
+  site.seconds += seconds;
+  for(int k = 0; k < nCounters; k++)
+    if(vCounts[k] == -1 || vEnds[k] == -1 || site.vCounts[k] == -1)
+      site.vCounts[k] = -1;
+    else
+      site.vCounts[k] += vEnds[k] - vCounts[k];
+}
+
+// Sites with the same name are merged, and phases are listed by time.
+void TransductionPerf::Report(ostream &os) {
+  lock_guard<mutex> lock(mtx);
+  map<string, vector<long long> > counts;
+  map<string, pair<long long, double> > calls;
+  for(unsigned i = 0; i < vSites.size(); i++) {
+    Site const &site = *vSites[i];
+    if(!site.nCalls)
+      continue;
+    vector<long long> &v = counts[site.name];
+    v.resize(nCounters);
+    for(int k = 0; k < nCounters; k++)
+      v[k] = (v[k] == -1 || site.vCounts[k] == -1)? -1: v[k] + site.vCounts[k];
+    calls[site.name].first += site.nCalls;
+    calls[site.name].second += site.seconds;
+  }
+  vector<string> names;
+  for(map<string, pair<long long, double> >::iterator it = calls.begin(); it != calls.end(); it++)
+    names.push_back(it->first);
+  stable_sort(names.begin(), names.end(), [&](string const &a, string const &b) { return calls[a].second > calls[b].second; });
+  if(names.empty())
+    return;
+  os << left << setw(20) << "phase" << right << setw(10) << "calls" << setw(12) << "time(s)" << setw(16) << "cycles" << setw(16) << "instructions" << setw(7) << "ipc" << setw(14) << "llc-misses" << setw(14) << "br-misses" << endl;
+  for(unsigned i = 0; i < names.size(); i++) {
+    vector<long long> const &v = counts[names[i]];
+    os << left << setw(20) << names[i] << right << setw(10) << calls[names[i]].first << setw(12) << fixed << setprecision(3) << calls[names[i]].second;
+    for(int k = 0; k < nCounters; k++) {
+      int w = k < 2? 16: 14;
+      if(v[k] == -1)
+        os << setw(w) << "-";
+      else
+        os << setw(w) << v[k];
+      if(k == 1) {
+        if(v[0] > 0 && v[1] != -1)
+          os << setw(7) << setprecision(2) << (double)v[1] / v[0];
+        else
+          os << setw(7) << "-";
+      }
+    }
+    os << endl;
+  }
+}
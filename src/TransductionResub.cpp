@@ -1,5 +1,7 @@
 #include <iostream>
 #include <algorithm>
+#include <cmath>
+#include <thread>
 
 #include "Transduction.h"
 
@@ -9,36 +11,150 @@ bool Transduction::TryConnect(int i, int i0, bool c0) {
   int f = (i0 << 1) ^ (int)c0;
   if(find(vvFis[i].begin(), vvFis[i].end(), f) == vvFis[i].end()) {
     lit x = man->Or(man->LitNot(vFs[i]), vGs[i]);
-    IncRef(x);
-    if(man->IsConst1(man->Or(x, man->LitNotCond(vFs[i0], c0)))) {
-      DecRef(x);
-      if(nVerbose > 3)
+    if(Implies(man->LitNot(x), man->LitNotCond(vFs[i0], c0))) {
+      if(Verbose(4))
         cout << "\t\t\tConnect " << i0 << "(" << c0 << ")" << std::endl;
       Connect(i, f, true);
       return true;
     }
-    DecRef(x);
   }
   return false;
 }
 
-int Transduction::Resub(bool fMspf) {
-  if(nVerbose)
+void Transduction::SetSchedule(bool fPrioritize_, double nMinYield_) {
+  fPrioritize = fPrioritize_;
+  nMinYield = nMinYield_;
+}
+
+void Transduction::SetResubThreads(int nThreads) {
+  nResubThreads = nThreads;
+}
+
+// Whether vCands[j] in polarity c, for j from begin, passes TryConnect
+// for i in the current network, in vPass[2 * j + c]. A candidate is first
+// screened by simulation: it must be 1 on every pattern where i is 1 and
+// complementing i changes some po, which the care set of i always
+// contains. The survivors are checked exactly as in TryConnect. Both
+// checks only read the network and the manager, so the candidates are
+// split among nResubThreads threads, each with its own memo of disjoint
+// pairs.
+void Transduction::ScreenCands(int i, vector<int> const &vCands, unsigned begin, vector<char> &vPass) {
+  TRANSDUCTION_PERF_SCOPE("ScreenCands");
+  vPass.resize(2 * vCands.size());
+  fill(vPass.begin() + 2 * begin, vPass.end(), 1);
+  if(!nResubThreads)
+    return;
+  if(!nSimWords || vSimPats.size() != vPis.size() * nSimWords)
+    ResetPatterns(4);
+  vector<word> vSims, vSims2, vCare;
+  Simulate(vSims);
+  NewTravId();
+  MarkFoCone(i);
+  SimulateCare(i, vSims, vSims2, vCare);
+  for(int k = 0; k < nSimWords; k++)
+    vCare[k] &= vSims[(size_t)i * nSimWords + k];
+  LitRef x(man, man->Or(man->LitNot(vFs[i]), vGs[i]));
+  lit y = man->LitNot(x);
+  auto screen = [&](unsigned from, unsigned to) {
+    TRANSDUCTION_TRACE_SCOPE_ARG("ScreenCands", i);
+    DisjointMemo memo;
+    for(unsigned j = from; j < to; j++) {
+      word const *q = &vSims[(size_t)vCands[j] * nSimWords];
+      for(int k = 0; k < nSimWords; k++) {
+        if(vCare[k] & ~q[k])
+          vPass[2 * j] = 0;
+        if(vCare[k] & q[k])
+          vPass[2 * j + 1] = 0;
+      }
+      if(vFs[vCands[j]] == LitMax())
+        continue;
+      for(int c = 0; c < 2; c++)
+        if(vPass[2 * j + c])
+          vPass[2 * j + c] = Implies(y, man->LitNotCond(vFs[vCands[j]], c), memo);
+    }
+  };
+  unsigned n = vCands.size() - begin;
+  unsigned nThreads = min<unsigned>(nResubThreads, n / 64 + 1);
+  vector<thread> threads;
+  for(unsigned t = 1; t < nThreads; t++)
+    threads.emplace_back(screen, begin + n * t / nThreads, begin + n * (t + 1) / nThreads);
+  screen(begin, begin + n / nThreads);
+  for(unsigned t = 0; t < threads.size(); t++)
+    threads[t].join();
+}
+
+// Estimated gain of resubstituting i from the wires it may lose, how
+// widely it is used, the fraction of its don't-cares, and how much it
+// gained as a target before.
+double Transduction::TargetGain(int i) {
+  double gain = vvFis[i].size() - 1 + log2(1.0 + vvFos[i].size());
+  if(nSortType && vGs[i] != LitMax())
+    gain += ldexp((double)man->OneCount(vGs[i]), -(int)vPis.size());
+  return gain + vHists[i];
+}
+
+// Targets in reverse topological order, or by decreasing estimated gain.
+void Transduction::ScheduleTargets(vector<int> &vTargets) {
+  vTargets.assign(vObjs.rbegin(), vObjs.rend());
+  nYieldTargets = 0;
+  yieldGain = yieldSecs = 0;
+  yieldTime = chrono::steady_clock::now();
+  if(!fPrioritize)
+    return;
+  vector<pair<double, int> > vGains(vTargets.size());
+  for(unsigned k = 0; k < vTargets.size(); k++)
+    vGains[k] = make_pair(-TargetGain(vTargets[k]), k);
+  stable_sort(vGains.begin(), vGains.end());
+  vector<int> vTargets2(vTargets.size());
+  for(unsigned k = 0; k < vGains.size(); k++)
+    vTargets2[k] = vTargets[vGains[k].second];
+  vTargets.swap(vTargets2);
+}
+
+// Record the gain of a target, and tell whether the recent yield per
+// second has fallen below nMinYield, in which case the pass should stop.
+bool Transduction::Progress(int i, int gain) {
+  vHists[i] = 0.5 * vHists[i] + gain;
+  chrono::steady_clock::time_point now = chrono::steady_clock::now();
+  yieldGain = 0.9 * yieldGain + gain;
+  yieldSecs = 0.9 * yieldSecs + chrono::duration<double>(now - yieldTime).count();
+  yieldTime = now;
+  nYieldTargets++;
+  if(nMinYield > 0 && nYieldTargets >= 16 && yieldGain < nMinYield * yieldSecs) {
+    if(Verbose(2))
+      cout << "\tStop early after " << nYieldTargets << " targets" << endl;
+    return true;
+  }
+  return false;
+}
+
+template <bool fLevel_, bool fMspf_>
+int Transduction::ResubT() {
+  if(Verbose(1))
     cout << "Resubstitution" << endl;
-  int count = fMspf? Mspf(true): Cspf(true);
+  TRANSDUCTION_TRACE_SCOPE("Resub");
+  TRANSDUCTION_PERF_SCOPE("Resub");
+  int count = fMspf_? Mspf(true): Cspf(true);
+  Recycle(true);
   int nodes = CountNodes();
   TransductionBackup b;
   Save(b);
   int count_ = count;
-  list<int> targets = vObjs;
-  for(list<int>::reverse_iterator it = targets.rbegin(); it != targets.rend(); it++) {
-    if(nVerbose > 1)
+  vector<int> vTargets;
+  ScheduleTargets(vTargets);
+  int countT = count;
+  bool fStop = false;
+  // Progress is in the increment so that skipped targets are counted too.
+  for(vector<int>::iterator it = vTargets.begin(); !fStop && it != vTargets.end(); fStop = Progress(*it, count - countT), it++) {
+    countT = count;
+    if(Verbose(2))
       cout << "\tResubstitute " << *it << endl;
-    if(vvFos[*it].empty())
+    TRANSDUCTION_TRACE_SCOPE_ARG("ResubTarget", *it);
+    if(vvFos[*it].empty() || vFrozen[*it])
       continue;
     count += TrivialMergeOne(*it);
     vector<bool> lev;
-    if(fLevel) {
+    if(fLevel_) {
       for(unsigned j = 0; j < vvFis[*it].size(); j++)
         add(lev, vLevels[vvFis[*it][j] >> 1]);
       if((int)lev.size() > vLevels[*it] + vSlacks[*it]) {
@@ -49,23 +165,23 @@ int Transduction::Resub(bool fMspf) {
       lev.resize(vLevels[*it] + vSlacks[*it]);
     }
     bool fConnect = false;
-    vector<bool> vMarks(nObjsAlloc);
-    MarkFoCone_rec(vMarks, *it);
+    NewTravId();
+    MarkFoCone(*it);
     list<int> targets2 = vObjs;
     for(list<int>::iterator it2 = targets2.begin(); it2 != targets2.end(); it2++) {
-      if(fLevel && (int)lev.size() > vLevels[*it] + vSlacks[*it])
+      if(fLevel_ && (int)lev.size() > vLevels[*it] + vSlacks[*it])
         break;
-      if(!vMarks[*it2] && !vvFos[*it2].empty())
-        if(!fLevel || noexcess(lev, vLevels[*it2]))
+      if(!IsTravIdCurrent(*it2) && !vvFos[*it2].empty())
+        if(!fLevel_ || noexcess(lev, vLevels[*it2]))
           if(TryConnect(*it, *it2, false) || TryConnect(*it, *it2, true)) {
             fConnect = true;
             count--;
-            if(fLevel)
+            if(fLevel_)
               add(lev, vLevels[*it2]);
           }
     }
     if(fConnect) {
-      if(fMspf) {
+      if(fMspf_) {
         Build();
         count += Mspf(true, *it);
       } else {
@@ -74,7 +190,7 @@ int Transduction::Resub(bool fMspf) {
       }
       if(!vvFos[*it].empty()) {
         vPfUpdates[*it] = true;
-        count += fMspf? Mspf(true): Cspf(true);
+        count += fMspf_? Mspf(true): Cspf(true);
       }
     }
     if(nodes < CountNodes()) {
@@ -84,40 +200,56 @@ int Transduction::Resub(bool fMspf) {
     }
     if(!vvFos[*it].empty() && vvFis[*it].size() > 2) {
       list<int>::iterator it2 = find(vObjs.begin(), vObjs.end(), *it);
-      int pos = nObjsAlloc;
-      if(fLevel)
-        count += BalancedDecomposeOne(it2, pos) + (fMspf? Mspf(true): Cspf(true));
+      if(fLevel_)
+        count += BalancedDecomposeOne(it2) + (fMspf_? Mspf(true): Cspf(true));
       else
-        count += TrivialDecomposeOne(it2, pos);
+        count += TrivialDecomposeOne(it2);
     }
     nodes = CountNodes();
     Save(b);
     count_ = count;
   }
+  if(fMspf_ && nMspfWindow)
+    count += Mspf(true);
   return count;
 }
 
-int Transduction::ResubMono(bool fMspf) {
-  if(nVerbose)
+template <bool fLevel_, bool fMspf_>
+int Transduction::ResubMonoT() {
+  if(Verbose(1))
     cout << "Resubstitution mono" << endl;
-  int count = fMspf? Mspf(true): Cspf(true);
-  list<int> targets = vObjs;
-  for(list<int>::reverse_iterator it = targets.rbegin(); it != targets.rend(); it++) {
-    if(nVerbose > 1)
+  TRANSDUCTION_TRACE_SCOPE("ResubMono");
+  TRANSDUCTION_PERF_SCOPE("ResubMono");
+  int count = fMspf_? Mspf(true): Cspf(true);
+  Recycle(true);
+  vector<int> vTargets;
+  ScheduleTargets(vTargets);
+  int countT = count;
+  bool fStop = false;
+  vector<char> vPass;
+  for(vector<int>::iterator it = vTargets.begin(); !fStop && it != vTargets.end(); fStop = Progress(*it, count - countT), it++) {
+    countT = count;
+    if(Verbose(2))
       cout << "\tResubstitute mono " << *it << endl;
-    if(vvFos[*it].empty())
+    TRANSDUCTION_TRACE_SCOPE_ARG("ResubMonoTarget", *it);
+    if(vvFos[*it].empty() || vFrozen[*it])
       continue;
     count += TrivialMergeOne(*it);
     TransductionBackup b;
     Save(b);
     int count_ = count;
+    bool fScreen = true;
     for(unsigned i = 0; i < vPis.size(); i++) {
       if(vvFos[*it].empty())
         break;
-      if(TryConnect(*it, vPis[i], false) || TryConnect(*it, vPis[i], true)) {
+      if(fScreen) {
+        ScreenCands(*it, vPis, i, vPass);
+        fScreen = false;
+      }
+      if((vPass[2 * i] && TryConnect(*it, vPis[i], false)) || (vPass[2 * i + 1] && TryConnect(*it, vPis[i], true))) {
         count--;
         int diff;
-        if(fMspf) {
+        if(fMspf_) {
           Build();
           diff = Mspf(true, *it, vPis[i]);
         } else {
@@ -128,14 +260,15 @@ int Transduction::ResubMono(bool fMspf) {
           count += diff;
           if(!vvFos[*it].empty()) {
             vPfUpdates[*it] = true;
-            count += fMspf? Mspf(true): Cspf(true);
+            count += fMspf_? Mspf(true): Cspf(true);
           }
-          if(fLevel && CountLevels() > nMaxLevels) {
+          if(fLevel_ && CountLevels() > nMaxLevels) {
             Load(b);
             count = count_;
           } else {
             Save(b);
             count_ = count;
+            fScreen = true;
           }
         } else {
           Load(b);
@@ -145,65 +278,86 @@ int Transduction::ResubMono(bool fMspf) {
     }
     if(vvFos[*it].empty())
       continue;
-    vector<bool> vMarks(nObjsAlloc);
-    MarkFoCone_rec(vMarks, *it);
-    list<int> targets2 = vObjs;
-    for(list<int>::iterator it2 = targets2.begin(); it2 != targets2.end(); it2++) {
+    NewTravId();
+    MarkFoCone(*it);
+    vector<int> vCands;
+    for(list<int>::iterator it2 = vObjs.begin(); it2 != vObjs.end(); it2++)
+      if(!IsTravIdCurrent(*it2))
+        vCands.push_back(*it2);
+    fScreen = true;
+    for(unsigned j = 0; j < vCands.size(); j++) {
       if(vvFos[*it].empty())
         break;
-      if(!vMarks[*it2] && !vvFos[*it2].empty())
-        if(TryConnect(*it, *it2, false) || TryConnect(*it, *it2, true)) {
-          count--;
-          int diff;
-          if(fMspf) {
-            Build();
-            diff = Mspf(true, *it, *it2);
-          } else {
+      if(vvFos[vCands[j]].empty())
+        continue;
+      if(fScreen) {
+        ScreenCands(*it, vCands, j, vPass);
+        fScreen = false;
+      }
+      if((vPass[2 * j] && TryConnect(*it, vCands[j], false)) || (vPass[2 * j + 1] && TryConnect(*it, vCands[j], true))) {
+        count--;
+        int diff;
+        if(fMspf_) {
+          Build();
+          diff = Mspf(true, *it, vCands[j]);
+        } else {
+          vPfUpdates[*it] = true;
+          diff = Cspf(true, *it, vCands[j]);
+        }
+        if(diff) {
+          count += diff;
+          if(!vvFos[*it].empty()) {
             vPfUpdates[*it] = true;
-            diff = Cspf(true, *it, *it2);
+            count += fMspf_? Mspf(true): Cspf(true);
           }
-          if(diff) {
-            count += diff;
-            if(!vvFos[*it].empty()) {
-              vPfUpdates[*it] = true;
-              count += fMspf? Mspf(true): Cspf(true);
-            }
-            if(fLevel && CountLevels() > nMaxLevels) {
-              Load(b);
-              count = count_;
-            } else {
-              Save(b);
-              count_ = count;
-            }
-          } else {
+          if(fLevel_ && CountLevels() > nMaxLevels) {
             Load(b);
             count = count_;
+          } else {
+            Save(b);
+            count_ = count;
+            fScreen = true;
           }
+        } else {
+          Load(b);
+          count = count_;
         }
+      }
     }
     if(vvFos[*it].empty())
       continue;
     if(vvFis[*it].size() > 2) {
       list<int>::iterator it2 = find(vObjs.begin(), vObjs.end(), *it);
-      int pos = nObjsAlloc;
-      if(fLevel)
-        count += BalancedDecomposeOne(it2, pos) + (fMspf? Mspf(true): Cspf(true));
+      if(fLevel_)
+        count += BalancedDecomposeOne(it2) + (fMspf_? Mspf(true): Cspf(true));
       else
-        count += TrivialDecomposeOne(it2, pos);
+        count += TrivialDecomposeOne(it2);
     }
   }
+  if(fMspf_ && nMspfWindow)
+    count += Mspf(true);
   return count;
 }
 
-int Transduction::ResubShared(bool fMspf) {
-  if(nVerbose)
+template <bool fMspf_>
+int Transduction::ResubSharedT() {
+  if(Verbose(1))
     cout << "Merge" << endl;
-  int count = fMspf? Mspf(true): Cspf(true);
+  TRANSDUCTION_TRACE_SCOPE("ResubShared");
+  TRANSDUCTION_PERF_SCOPE("ResubShared");
+  int count = fMspf_? Mspf(true): Cspf(true);
+  Recycle(true);
   list<int> targets = vObjs;
-  for(list<int>::reverse_iterator it = targets.rbegin(); it != targets.rend(); it++) {
-    if(nVerbose > 1)
+  vector<int> vTargets;
+  ScheduleTargets(vTargets);
+  int countT = count;
+  bool fStop = false;
+  for(vector<int>::iterator it = vTargets.begin(); !fStop && it != vTargets.end(); fStop = Progress(*it, count - countT), it++) {
+    countT = count;
+    if(Verbose(2))
       cout << "\tMerge " << *it << endl;
-    if(vvFos[*it].empty())
+    TRANSDUCTION_TRACE_SCOPE_ARG("ResubSharedTarget", *it);
+    if(vvFos[*it].empty() || vFrozen[*it])
       continue;
     count += TrivialMergeOne(*it);
     bool fConnect = false;
@@ -212,16 +366,16 @@ int Transduction::ResubShared(bool fMspf) {
         fConnect |= true;
         count--;
       }
-    vector<bool> vMarks(nObjsAlloc);
-    MarkFoCone_rec(vMarks, *it);
+    NewTravId();
+    MarkFoCone(*it);
     for(list<int>::iterator it2 = targets.begin(); it2 != targets.end(); it2++)
-      if(!vMarks[*it2] && !vvFos[*it2].empty())
+      if(!IsTravIdCurrent(*it2) && !vvFos[*it2].empty())
         if(TryConnect(*it, *it2, false) || TryConnect(*it, *it2, true)) {
           fConnect |= true;
           count--;
         }
     if(fConnect) {
-      if(fMspf) {
+      if(fMspf_) {
         Build();
         count += Mspf(true, *it);
       } else {
@@ -230,9 +384,32 @@ int Transduction::ResubShared(bool fMspf) {
       }
       if(!vvFos[*it].empty()) {
         vPfUpdates[*it] = true;
-        count += fMspf? Mspf(true): Cspf(true);
+        count += fMspf_? Mspf(true): Cspf(true);
       }
     }
   }
   return count + Decompose();
 }
+
+int Transduction::Resub(bool fMspf) {
+  if(fLevel)
+    return fMspf? ResubT<true, true>(): ResubT<true, false>();
+  return fMspf? ResubT<false, true>(): ResubT<false, false>();
+}
+int Transduction::ResubMono(bool fMspf) {
+  if(fLevel)
+    return fMspf? ResubMonoT<true, true>(): ResubMonoT<true, false>();
+  return fMspf? ResubMonoT<false, true>(): ResubMonoT<false, false>();
+}
+int Transduction::ResubShared(bool fMspf) {
+  return fMspf? ResubSharedT<true>(): ResubSharedT<false>();
+}
+
+template int Transduction::ResubT<false, false>();
+template int Transduction::ResubT<false, true>();
+template int Transduction::ResubT<true, false>();
+template int Transduction::ResubT<true, true>();
+template int Transduction::ResubMonoT<false, false>();
+template int Transduction::ResubMonoT<false, true>();
+template int Transduction::ResubMonoT<true, false>();
+template int Transduction::ResubMonoT<true, true>();
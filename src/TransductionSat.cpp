@@ -0,0 +1,402 @@
+#include <algorithm>
+#include <cassert>
+
+#include "TransductionSat.h"
+
+using namespace std;
+
+static long long Luby(int k) {
+  long long size = 1;
+  int seq = 0;
+  while(size < k + 1) {
+    seq++;
+    size = 2 * size + 1;
+  }
+  long long x = 1;
+  while(size - 1 != k) {
+    size = (size - 1) >> 1;
+    seq--;
+    k = k % size;
+  }
+  for(; seq > 0; seq--)
+    x *= 2;
+  return x;
+}
+
+TransductionSat::TransductionSat(): fOk(true), fDeadline(false), qhead(0), varInc(1), claInc(1), nLearnts(0), nMaxLearnts(2000) {}
+
+int TransductionSat::NewVar() {
+  int v = vAssigns.size();
+  vAssigns.push_back(-1);
+  vPhases.push_back(false);
+  vLevels.push_back(0);
+  vReasons.push_back(-1);
+  vActs.push_back(0);
+  vSeen.push_back(false);
+  vHeapIdxs.push_back(-1);
+  vvWatches.resize(vvWatches.size() + 2);
+  HeapInsert(v);
+  return v;
+}
+int TransductionSat::NumVars() const {
+  return vAssigns.size();
+}
+
+bool TransductionSat::AddClause(vector<int> vLits) {
+  assert(Level() == 0);
+  if(!fOk)
+    return false;
+  sort(vLits.begin(), vLits.end());
+  unsigned j = 0;
+  for(unsigned i = 0; i < vLits.size(); i++) {
+    if(LitValue(vLits[i]) == 1 || (i && vLits[i] == (vLits[i - 1] ^ 1)))
+      return true;
+    if(LitValue(vLits[i]) == 0 || (i && vLits[i] == vLits[i - 1]))
+      continue;
+    vLits[j++] = vLits[i];
+  }
+  vLits.resize(j);
+  if(vLits.empty()) {
+    fOk = false;
+    return false;
+  }
+  if(vLits.size() == 1) {
+    Enqueue(vLits[0], -1);
+    fOk = Propagate() == -1;
+    return fOk;
+  }
+  Clause c = {vLits, false, 0};
+  vClauses.push_back(c);
+  Attach(vClauses.size() - 1);
+  return true;
+}
+
+void TransductionSat::SetDeadline(chrono::steady_clock::time_point deadline_) {
+  fDeadline = true;
+  deadline = deadline_;
+}
+
+bool TransductionSat::Value(int v) const {
+  return vModel[v];
+}
+
+void TransductionSat::Attach(int c) {
+  vvWatches[vClauses[c].vLits[0]].push_back(c);
+  vvWatches[vClauses[c].vLits[1]].push_back(c);
+}
+
+void TransductionSat::Enqueue(int x, int c) {
+  int v = x >> 1;
+  vAssigns[v] = !(x & 1);
+  vLevels[v] = Level();
+  vReasons[v] = c;
+  vTrail.push_back(x);
+}
+
+// A clause is watched by its first two literals and visited when one of
+// them becomes false. The implied literal of a reason is its first one.
+int TransductionSat::Propagate() {
+  while(qhead < vTrail.size()) {
+    int x = vTrail[qhead++] ^ 1;
+    vector<int> &ws = vvWatches[x];
+    unsigned i = 0, j = 0;
+    for(; i < ws.size(); i++) {
+      int c = ws[i];
+      vector<int> &vLits = vClauses[c].vLits;
+      if(vLits[0] == x)
+        swap(vLits[0], vLits[1]);
+      if(LitValue(vLits[0]) == 1) {
+        ws[j++] = c;
+        continue;
+      }
+      unsigned k = 2;
+      for(; k < vLits.size(); k++)
+        if(LitValue(vLits[k]) != 0)
+          break;
+      if(k < vLits.size()) {
+        swap(vLits[1], vLits[k]);
+        vvWatches[vLits[1]].push_back(c);
+        continue;
+      }
+      ws[j++] = c;
+      if(LitValue(vLits[0]) == 0) {
+        for(i++; i < ws.size(); i++)
+          ws[j++] = ws[i];
+        ws.resize(j);
+        qhead = vTrail.size();
+        return c;
+      }
+      Enqueue(vLits[0], c);
+    }
+    ws.resize(j);
+  }
+  return -1;
+}
+
+void TransductionSat::Analyze(int c, vector<int> &vLearnt, int &level) {
+  vLearnt.assign(1, -1);
+  int nPaths = 0;
+  int x = -1;
+  int idx = vTrail.size() - 1;
+  do {
+    if(vClauses[c].fLearnt)
+      BumpClause(c);
+    vector<int> const &vLits = vClauses[c].vLits;
+    for(unsigned j = (x == -1)? 0: 1; j < vLits.size(); j++) {
+      int v = vLits[j] >> 1;
+      if(vSeen[v] || vLevels[v] == 0)
+        continue;
+      vSeen[v] = true;
+      BumpVar(v);
+      if(vLevels[v] >= Level())
+        nPaths++;
+      else
+        vLearnt.push_back(vLits[j]);
+    }
+    while(!vSeen[vTrail[idx] >> 1])
+      idx--;
+    x = vTrail[idx--];
+    c = vReasons[x >> 1];
+    vSeen[x >> 1] = false;
+    nPaths--;
+  } while(nPaths > 0);
+  vLearnt[0] = x ^ 1;
+  // drop literals implied by the others
+  vector<int> vMarked(vLearnt.begin() + 1, vLearnt.end());
+  unsigned j = 1;
+  for(unsigned i = 1; i < vLearnt.size(); i++) {
+    int r = vReasons[vLearnt[i] >> 1];
+    bool fKeep = r == -1;
+    for(unsigned k = 1; !fKeep && k < vClauses[r].vLits.size(); k++) {
+      int v = vClauses[r].vLits[k] >> 1;
+      fKeep = !vSeen[v] && vLevels[v] > 0;
+    }
+    if(fKeep)
+      vLearnt[j++] = vLearnt[i];
+  }
+  vLearnt.resize(j);
+  for(unsigned i = 0; i < vMarked.size(); i++)
+    vSeen[vMarked[i] >> 1] = false;
+  level = 0;
+  for(unsigned i = 1; i < vLearnt.size(); i++)
+    if(vLevels[vLearnt[i] >> 1] > level) {
+      level = vLevels[vLearnt[i] >> 1];
+      swap(vLearnt[1], vLearnt[i]);
+    }
+}
+
+void TransductionSat::Cancel(int level) {
+  if(Level() <= level)
+    return;
+  for(int i = vTrail.size() - 1; i >= vTrailLims[level]; i--) {
+    int v = vTrail[i] >> 1;
+    vPhases[v] = vAssigns[v];
+    vAssigns[v] = -1;
+    vReasons[v] = -1;
+    HeapInsert(v);
+  }
+  vTrail.resize(vTrailLims[level]);
+  vTrailLims.resize(level);
+  qhead = vTrail.size();
+}
+
+// Called at level 0 after propagation. Satisfied clauses and false
+// literals are removed, together with the less active half of the learnt
+// clauses, and the watches are rebuilt.
+void TransductionSat::Reduce() {
+  assert(Level() == 0);
+  vector<double> vLearntActs;
+  for(unsigned c = 0; c < vClauses.size(); c++)
+    if(vClauses[c].fLearnt && vClauses[c].vLits.size() > 2)
+      vLearntActs.push_back(vClauses[c].act);
+  double limit = -1;
+  if(!vLearntActs.empty()) {
+    nth_element(vLearntActs.begin(), vLearntActs.begin() + vLearntActs.size() / 2, vLearntActs.end());
+    limit = vLearntActs[vLearntActs.size() / 2];
+  }
+  unsigned j = 0;
+  nLearnts = 0;
+  for(unsigned c = 0; c < vClauses.size(); c++) {
+    Clause &cl = vClauses[c];
+    if(cl.fLearnt && cl.vLits.size() > 2 && cl.act < limit)
+      continue;
+    bool fSat = false;
+    unsigned k = 0;
+    for(unsigned i = 0; i < cl.vLits.size(); i++) {
+      int r = LitValue(cl.vLits[i]);
+      fSat |= r == 1;
+      if(r == -1)
+        cl.vLits[k++] = cl.vLits[i];
+    }
+    if(fSat)
+      continue;
+    assert(k >= 2);
+    cl.vLits.resize(k);
+    nLearnts += cl.fLearnt;
+    if(j != c)
+      vClauses[j] = vClauses[c];
+    j++;
+  }
+  vClauses.resize(j);
+  for(unsigned i = 0; i < vTrail.size(); i++)
+    vReasons[vTrail[i] >> 1] = -1;
+  for(unsigned i = 0; i < vvWatches.size(); i++)
+    vvWatches[i].clear();
+  for(unsigned c = 0; c < vClauses.size(); c++)
+    Attach(c);
+}
+
+int TransductionSat::Search(vector<int> const &vAssumps, long long nConfs, long long &nConfsDone) {
+  vector<int> vLearnt;
+  nConfsDone = 0;
+  while(true) {
+    int c = Propagate();
+    if(c != -1) {
+      nConfsDone++;
+      if(Level() == 0) {
+        fOk = false;
+        return 0;
+      }
+      int level;
+      Analyze(c, vLearnt, level);
+      Cancel(level);
+      if(vLearnt.size() == 1)
+        Enqueue(vLearnt[0], -1);
+      else {
+        Clause cl = {vLearnt, true, 0};
+        vClauses.push_back(cl);
+        Attach(vClauses.size() - 1);
+        BumpClause(vClauses.size() - 1);
+        Enqueue(vLearnt[0], vClauses.size() - 1);
+        nLearnts++;
+      }
+      varInc /= 0.95;
+      claInc /= 0.999;
+      if(fDeadline && !(nConfsDone & 255) && chrono::steady_clock::now() > deadline)
+        return -1;
+      continue;
+    }
+    if(nConfsDone >= nConfs)
+      return -1;
+    int x = -1;
+    while(Level() < (int)vAssumps.size()) {
+      int a = vAssumps[Level()];
+      if(LitValue(a) == 1)
+        vTrailLims.push_back(vTrail.size());
+      else if(LitValue(a) == 0)
+        return 0;
+      else {
+        x = a;
+        break;
+      }
+    }
+    if(x == -1) {
+      int v = -1;
+      while(v == -1 && !vHeap.empty()) {
+        v = HeapPop();
+        if(vAssigns[v] >= 0)
+          v = -1;
+      }
+      if(v == -1) {
+        vModel.resize(vAssigns.size());
+        for(unsigned i = 0; i < vAssigns.size(); i++)
+          vModel[i] = vAssigns[i] == 1;
+        return 1;
+      }
+      x = (v << 1) ^ !vPhases[v];
+    }
+    vTrailLims.push_back(vTrail.size());
+    Enqueue(x, -1);
+  }
+}
+
+int TransductionSat::Solve(vector<int> const &vAssumps, long long nConfLimit) {
+  long long nConfs = 0;
+  for(int k = 0; fOk; k++) {
+    if(Propagate() != -1) {
+      fOk = false;
+      break;
+    }
+    if(nLearnts >= nMaxLearnts) {
+      Reduce();
+      nMaxLearnts += nMaxLearnts / 10;
+    }
+    if(fDeadline && chrono::steady_clock::now() > deadline)
+      return -1;
+    long long n = 100 * Luby(k);
+    if(nConfLimit >= 0) {
+      if(nConfs >= nConfLimit)
+        return -1;
+      n = min(n, nConfLimit - nConfs);
+    }
+    long long nDone;
+    int r = Search(vAssumps, n, nDone);
+    nConfs += nDone;
+    Cancel(0);
+    if(r != -1)
+      return r;
+  }
+  return 0;
+}
+
+void TransductionSat::BumpVar(int v) {
+  vActs[v] += varInc;
+  if(vActs[v] > 1e100) {
+    for(unsigned i = 0; i < vActs.size(); i++)
+      vActs[i] *= 1e-100;
+    varInc *= 1e-100;
+  }
+  if(vHeapIdxs[v] != -1)
+    HeapUp(vHeapIdxs[v]);
+}
+void TransductionSat::BumpClause(int c) {
+  vClauses[c].act += claInc;
+  if(vClauses[c].act > 1e20) {
+    for(unsigned i = 0; i < vClauses.size(); i++)
+      vClauses[i].act *= 1e-20;
+    claInc *= 1e-20;
+  }
+}
+
+void TransductionSat::HeapUp(int k) {
+  int v = vHeap[k];
+  while(k > 0 && vActs[vHeap[(k - 1) >> 1]] < vActs[v]) {
+    vHeap[k] = vHeap[(k - 1) >> 1];
+    vHeapIdxs[vHeap[k]] = k;
+    k = (k - 1) >> 1;
+  }
+  vHeap[k] = v;
+  vHeapIdxs[v] = k;
+}
+void TransductionSat::HeapDown(int k) {
+  int v = vHeap[k];
+  while(2 * k + 1 < (int)vHeap.size()) {
+    int l = 2 * k + 1;
+    if(l + 1 < (int)vHeap.size() && vActs[vHeap[l + 1]] > vActs[vHeap[l]])
+      l++;
+    if(vActs[vHeap[l]] <= vActs[v])
+      break;
+    vHeap[k] = vHeap[l];
+    vHeapIdxs[vHeap[k]] = k;
+    k = l;
+  }
+  vHeap[k] = v;
+  vHeapIdxs[v] = k;
+}
+void TransductionSat::HeapInsert(int v) {
+  if(vHeapIdxs[v] != -1)
+    return;
+  vHeap.push_back(v);
+  HeapUp(vHeap.size() - 1);
+}
+int TransductionSat::HeapPop() {
+  int v = vHeap[0];
+  vHeapIdxs[v] = -1;
+  vHeap[0] = vHeap.back();
+  vHeap.pop_back();
+  if(!vHeap.empty()) {
+    vHeapIdxs[vHeap[0]] = 0;
+    HeapDown(0);
+  }
+  return v;
+}
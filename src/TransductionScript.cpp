@@ -1,12 +1,31 @@
+#include <iostream>
+#include <stdexcept>
+#include <cctype>
+#include <cstring>
+
 #include "Transduction.h"
 
-int Transduction::RepeatResub(bool fMono, bool fMspf) {
+using namespace std;
+
+template <bool fMono, bool fLevel_, bool fMspf_>
+int Transduction::RepeatResubT() {
   int count = 0;
-  while(int diff = fMono? ResubMono(fMspf): Resub(fMspf))
+  while(int diff = fMono? ResubMonoT<fLevel_, fMspf_>(): ResubT<fLevel_, fMspf_>())
     count += diff;
   return count;
 }
 
+int Transduction::RepeatResub(bool fMono, bool fMspf) {
+  if(fMono) {
+    if(fLevel)
+      return fMspf? RepeatResubT<true, true, true>(): RepeatResubT<true, true, false>();
+    return fMspf? RepeatResubT<true, false, true>(): RepeatResubT<true, false, false>();
+  }
+  if(fLevel)
+    return fMspf? RepeatResubT<false, true, true>(): RepeatResubT<false, true, false>();
+  return fMspf? RepeatResubT<false, false, true>(): RepeatResubT<false, false, false>();
+}
+
 int Transduction::RepeatResubInner(bool fMspf, bool fInner) {
   int count = 0;
   while(int diff = RepeatResub(true, fMspf) + RepeatResub(false, fMspf)) {
@@ -21,6 +40,8 @@ int Transduction::RepeatResubOuter(bool fMspf, bool fInner, bool fOuter) {
   int count = 0;
   while(int diff = fMspf? RepeatResubInner(false, fInner) + RepeatResubInner(true, fInner): RepeatResubInner(false, fInner)) {
     count += diff;
+    if(!checkpoint.empty())
+      WriteCheckpoint(checkpoint);
     if(!fOuter)
       break;
   }
@@ -39,6 +60,8 @@ int Transduction::Optimize(bool fFirstMerge, bool fMspfMerge, bool fMspfResub, b
     count = diff;
     Save(b);
     diff = 0;
+    if(!checkpoint.empty())
+      WriteCheckpoint(checkpoint);
   }
   while(true) {
     diff += ResubShared(fMspfMerge) + RepeatResubOuter(fMspfResub, fInner, fOuter);
@@ -46,10 +69,169 @@ int Transduction::Optimize(bool fFirstMerge, bool fMspfMerge, bool fMspfResub, b
       count += diff;
       Save(b);
       diff = 0;
+      if(!checkpoint.empty())
+        WriteCheckpoint(checkpoint);
     } else {
       Load(b);
+      if(!checkpoint.empty())
+        WriteCheckpoint(checkpoint);
       break;
     }
   }
   return count;
 }
+
+int Transduction::Optimize(TransductionConfig const &config) {
+  return Optimize(config.fFirstMerge, config.fMspfMerge, config.fMspfResub, config.fInner, config.fOuter);
+}
+
+// A flow is a string of passes, run from left to right. Lowercase passes
+// use cspf and uppercase ones mspf:
+//   s, S  ResubShared
+//   m, M  ResubMono
+//   r, R  Resub
+//   x     ResubSim
+// "(f)" repeats f while it removes wires, undoing an iteration that adds
+// wires. "{p}" runs the passes p adaptively, see RunFlowGroup. The passes
+// that took effect are recorded in FlowTrace. With nMinYield at 0, the
+// trace replays the run as a flow of its own; otherwise passes may stop
+// early depending on time, which the trace does not record.
+int Transduction::RunFlow(string const &flow) {
+  int depth = 0;
+  bool fGroup = false;
+  for(size_t i = 0; i < flow.size(); i++) {
+    char c = flow[i];
+    if(strchr("sSmMrRx", c))
+      continue;
+    if(c == '(' && !fGroup)
+      depth++;
+    else if(c == ')' && !fGroup && depth > 0 && flow[i - 1] != '(')
+      depth--;
+    else if(c == '{' && !fGroup)
+      fGroup = true;
+    else if(c == '}' && fGroup && flow[i - 1] != '{')
+      fGroup = false;
+    else
+      throw runtime_error("malformed flow \"" + flow + "\"");
+  }
+  if(depth || fGroup)
+    throw runtime_error("malformed flow \"" + flow + "\"");
+  flowTrace.clear();
+  size_t pos = 0;
+  return RunFlowSeq(flow, pos, 0);
+}
+
+string const &Transduction::FlowTrace() const {
+  return flowTrace;
+}
+
+int Transduction::RunPass(char c) {
+  if(Verbose(1))
+    cout << "Pass " << c << endl;
+  TRANSDUCTION_TRACE_SCOPE_ARG("Pass", c);
+  int count = 0;
+  switch(c) {
+  case 's':
+  case 'S':
+    count = ResubShared(c == 'S');
+    break;
+  case 'm':
+  case 'M':
+    count = ResubMono(c == 'M');
+    break;
+  case 'r':
+  case 'R':
+    count = Resub(c == 'R');
+    break;
+  case 'x':
+    count = ResubSim();
+    break;
+  }
+  flowTrace += c;
+  return count;
+}
+
+int Transduction::RunFlowSeq(string const &flow, size_t &pos, int depth) {
+  int count = 0;
+  while(pos < flow.size() && flow[pos] != ')') {
+    char c = flow[pos++];
+    if(c == '{') {
+      size_t end = flow.find('}', pos);
+      count += RunFlowGroup(flow.substr(pos, end - pos));
+      pos = end + 1;
+    } else if(c == '(') {
+      size_t begin = pos;
+      TransductionBackup b;
+      Save(b);
+      while(true) {
+        size_t trace = flowTrace.size();
+        pos = begin;
+        int diff = RunFlowSeq(flow, pos, depth + 1);
+        if(diff > 0) {
+          count += diff;
+          Save(b);
+          if(!depth && !checkpoint.empty())
+            WriteCheckpoint(checkpoint);
+          continue;
+        }
+        if(diff < 0) {
+          Load(b);
+          flowTrace.resize(trace);
+        }
+        break;
+      }
+      pos++;
+    } else
+      count += RunPass(c);
+  }
+  return count;
+}
+
+// The passes of a group run one at a time until none of them removes
+// wires. Mspf passes are held back until every cspf pass is saturated.
+// Among the others, a pass not run yet goes first, and then the one that
+// removed the most wires per second so far. A pass that does not bring
+// the wires of the group below their minimum so far is saturated until
+// another pass does, and a pass whose yield falls below nMinYield is not
+// run again.
+int Transduction::RunFlowGroup(string const &passes) {
+  int n = passes.size();
+  vector<int> vGains(n);
+  vector<double> vSecs(n);
+  vector<bool> vRun(n), vSaturated(n), vDropped(n);
+  int count = 0;
+  int nMinWires = CountWires();
+  while(true) {
+    bool fCspf = false;
+    for(int k = 0; k < n; k++)
+      if(islower(passes[k]) && !vSaturated[k] && !vDropped[k])
+        fCspf = true;
+    int best = -1;
+    for(int k = 0; k < n; k++) {
+      if(vSaturated[k] || vDropped[k] || (fCspf && isupper(passes[k])))
+        continue;
+      if(best == -1 || (!vRun[k] && vRun[best]) || (vRun[k] && vRun[best] && vGains[k] * vSecs[best] > vGains[best] * vSecs[k]))
+        best = k;
+    }
+    if(best == -1)
+      break;
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    int diff = RunPass(passes[best]);
+    vRun[best] = true;
+    vGains[best] += diff;
+    vSecs[best] += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    count += diff;
+    if(CountWires() < nMinWires) {
+      nMinWires = CountWires();
+      for(int k = 0; k < n; k++)
+        vSaturated[k] = false;
+    } else
+      vSaturated[best] = true;
+    if(nMinYield > 0 && vGains[best] < nMinYield * vSecs[best]) {
+      if(Verbose(2))
+        cout << "\tDrop pass " << passes[best] << endl;
+      vDropped[best] = true;
+    }
+  }
+  return count;
+}
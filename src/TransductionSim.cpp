@@ -0,0 +1,318 @@
+#include <iostream>
+#include <random>
+#include <algorithm>
+#include <cassert>
+
+#include "Transduction.h"
+#include "TransductionSat.h"
+
+using namespace std;
+
+void Transduction::ResetPatterns(int nWords) {
+  nSimWords = nWords;
+  nSimCexs = 0;
+  mt19937_64 rng(nWords);
+  vSimPats.resize(vPis.size() * nSimWords);
+  for(unsigned k = 0; k < vSimPats.size(); k++)
+    vSimPats[k] = rng();
+}
+
+// Pattern p of pi i+1 is bit p of vSimPats[i * nSimWords + p / 64].
+void Transduction::AddPattern(vector<int> const &vValues) {
+  int p = nSimCexs++ % (nSimWords * 64);
+  word m = 1ull << (p % 64);
+  for(unsigned i = 0; i < vPis.size(); i++) {
+    word &w = vSimPats[i * nSimWords + p / 64];
+    if(vValues[i] == 1)
+      w |= m;
+    else if(vValues[i] == 0)
+      w &= ~m;
+  }
+}
+
+void Transduction::SimulateGate(int i, vector<word> &vSims) const {
+  word *p = &vSims[(size_t)i * nSimWords];
+  fill(p, p + nSimWords, ~0ull);
+  for(unsigned j = 0; j < vvFis[i].size(); j++) {
+    word const *q = &vSims[(size_t)(vvFis[i][j] >> 1) * nSimWords];
+    word c = (vvFis[i][j] & 1)? ~0ull: 0;
+    for(int k = 0; k < nSimWords; k++)
+      p[k] &= q[k] ^ c;
+  }
+}
+void Transduction::Simulate(vector<word> &vSims) const {
+  TRANSDUCTION_PERF_SCOPE("Simulate");
+  vSims.assign((size_t)nObjsAlloc * nSimWords, 0);
+  copy(vSimPats.begin(), vSimPats.end(), vSims.begin() + nSimWords);
+  for(list<int>::const_iterator it = vObjs.begin(); it != vObjs.end(); it++)
+    SimulateGate(*it, vSims);
+}
+
+// Patterns where complementing i changes some po, assuming the fanout cone
+// of i is marked with the current travel id. vSims2 holds the complemented
+// values of the marked nodes.
+void Transduction::SimulateCare(int i, vector<word> const &vSims, vector<word> &vSims2, vector<word> &vCare) const {
+  vSims2.resize(vSims.size());
+  for(int k = 0; k < nSimWords; k++)
+    vSims2[(size_t)i * nSimWords + k] = ~vSims[(size_t)i * nSimWords + k];
+  for(list<int>::const_iterator it = vObjs.begin(); it != vObjs.end(); it++) {
+    if(*it == i || !IsTravIdCurrent(*it))
+      continue;
+    word *p = &vSims2[(size_t)*it * nSimWords];
+    fill(p, p + nSimWords, ~0ull);
+    for(unsigned j = 0; j < vvFis[*it].size(); j++) {
+      int i0 = vvFis[*it][j] >> 1;
+      word const *q = IsTravIdCurrent(i0)? &vSims2[(size_t)i0 * nSimWords]: &vSims[(size_t)i0 * nSimWords];
+      word c = (vvFis[*it][j] & 1)? ~0ull: 0;
+      for(int k = 0; k < nSimWords; k++)
+        p[k] &= q[k] ^ c;
+    }
+  }
+  vCare.assign(nSimWords, 0);
+  for(unsigned j = 0; j < vPos.size(); j++) {
+    int i0 = vvFis[vPos[j]][0] >> 1;
+    if(!IsTravIdCurrent(vPos[j]) || !IsTravIdCurrent(i0))
+      continue;
+    for(int k = 0; k < nSimWords; k++)
+      vCare[k] |= vSims[(size_t)i0 * nSimWords + k] ^ vSims2[(size_t)i0 * nSimWords + k];
+  }
+}
+
+// Fanins of i, together with f unless it is -1, that are redundant on the
+// care patterns. They are chosen greedily, keeping at least one fanin.
+void Transduction::SimulateRedundant(int i, int f, vector<word> const &vSims, vector<word> const &vCare, vector<unsigned> &vRedundants) const {
+  vector<int> vFis = vvFis[i];
+  if(f != -1)
+    vFis.push_back(f);
+  vector<bool> vRemoved(vFis.size());
+  vRedundants.clear();
+  vector<word> vAnd(nSimWords);
+  for(unsigned j = 0; j < vvFis[i].size(); j++) {
+    if(vFis.size() - vRedundants.size() == 1)
+      break;
+    fill(vAnd.begin(), vAnd.end(), ~0ull);
+    for(unsigned jj = 0; jj < vFis.size(); jj++) {
+      if(jj == j || vRemoved[jj])
+        continue;
+      word const *q = &vSims[(size_t)(vFis[jj] >> 1) * nSimWords];
+      word c = (vFis[jj] & 1)? ~0ull: 0;
+      for(int k = 0; k < nSimWords; k++)
+        vAnd[k] &= q[k] ^ c;
+    }
+    word const *q = &vSims[(size_t)(vFis[j] >> 1) * nSimWords];
+    word c = (vFis[j] & 1)? ~0ull: 0;
+    int k = 0;
+    for(; k < nSimWords; k++)
+      if(vCare[k] & vAnd[k] & ~(q[k] ^ c))
+        break;
+    if(k == nSimWords) {
+      vRemoved[j] = true;
+      vRedundants.push_back(j);
+    }
+  }
+}
+
+// Check that the pos keep their functions after a change to the fanout
+// cone of i, by a miter of the cone as saved in b and as it is now. Only
+// the fanin cones of the pos reached from i are encoded, and the nodes
+// outside the fanout cone of i are shared between the two sides. Returns 1
+// if equivalent, 0 if not with a counterexample in vValues indexed by pi,
+// and -1 if undecided within nConfLimit conflicts.
+int Transduction::CheckChange(int i, TransductionBackup const &b, vector<int> &vValues, long long nConfLimit) const {
+  TRANSDUCTION_PERF_SCOPE("CheckChange");
+  vector<bool> vCone(nObjsAlloc);
+  vector<int> vStack2(1, i);
+  while(!vStack2.empty()) {
+    int k = vStack2.back();
+    vStack2.pop_back();
+    if(vCone[k])
+      continue;
+    vCone[k] = true;
+    for(unsigned j = 0; j < b.vvFos[k].size(); j++)
+      vStack2.push_back(b.vvFos[k][j]);
+  }
+  TransductionSat sat;
+  vector<int> vOld(nObjsAlloc, -1), vNew(nObjsAlloc, -1);
+  // Node k of the changed side is encoded as 2 * k + 1, of the other as 2 * k.
+  auto Var = [&](int x) -> int & {
+    return (x & 1)? vNew[x >> 1]: vOld[x >> 1];
+  };
+  auto Side = [&](int k, bool fNew) {
+    return (k << 1) | (fNew && vCone[k]);
+  };
+  auto Encode = [&](int x) {
+    vStack2.assign(1, x);
+    while(!vStack2.empty()) {
+      int y = vStack2.back();
+      int k = y >> 1;
+      vector<int> const &vFis = (y & 1)? vvFis[k]: b.vvFis[k];
+      if(Var(y) != -1) {
+        vStack2.pop_back();
+        continue;
+      }
+      if(k == 0) {
+        Var(y) = sat.NewVar();
+        sat.AddClause(vector<int>(1, (Var(y) << 1) ^ 1));
+        continue;
+      }
+      if(vFis.empty()) {
+        Var(y) = sat.NewVar();
+        continue;
+      }
+      bool fReady = true;
+      for(unsigned j = 0; j < vFis.size(); j++)
+        if(Var(Side(vFis[j] >> 1, y & 1)) == -1) {
+          vStack2.push_back(Side(vFis[j] >> 1, y & 1));
+          fReady = false;
+        }
+      if(!fReady)
+        continue;
+      int z = sat.NewVar() << 1;
+      vector<int> vLits(1, z);
+      for(unsigned j = 0; j < vFis.size(); j++) {
+        int l = (Var(Side(vFis[j] >> 1, y & 1)) << 1) ^ (vFis[j] & 1);
+        sat.AddClause({z ^ 1, l});
+        vLits.push_back(l ^ 1);
+      }
+      sat.AddClause(vLits);
+      Var(y) = z >> 1;
+    }
+  };
+  vector<int> vDiffs;
+  for(unsigned j = 0; j < vPos.size(); j++) {
+    if(!vCone[vPos[j]])
+      continue;
+    int f0 = b.vvFis[vPos[j]][0], f1 = vvFis[vPos[j]][0];
+    int y0 = Side(f0 >> 1, false), y1 = Side(f1 >> 1, true);
+    Encode(y0);
+    Encode(y1);
+    int a = (Var(y0) << 1) ^ (f0 & 1), c = (Var(y1) << 1) ^ (f1 & 1);
+    if(a == c)
+      continue;
+    int d = sat.NewVar() << 1;
+    sat.AddClause({d ^ 1, a, c});
+    sat.AddClause({d ^ 1, a ^ 1, c ^ 1});
+    sat.AddClause({d, a ^ 1, c});
+    sat.AddClause({d, a, c ^ 1});
+    vDiffs.push_back(d);
+  }
+  if(vDiffs.empty())
+    return 1;
+  sat.AddClause(vDiffs);
+  int r = sat.Solve(vector<int>(), nConfLimit);
+  if(r != 1)
+    return r == 0? 1: -1;
+  vValues.assign(vPis.size(), -1);
+  for(unsigned j = 0; j < vPis.size(); j++)
+    if(vOld[vPis[j]] != -1)
+      vValues[vPis[j] - 1] = sat.Value(vOld[vPis[j]]);
+  return 0;
+}
+
+// Resubstitution driven by simulation. Care sets are approximated by
+// complementing each target on bit-parallel patterns, and each change found
+// on them is checked exactly by CheckChange. A failed change is undone and
+// its counterexample is added to the patterns, and an undecided one is
+// undone. Functions are rebuilt once at the end, only for the nodes that
+// changed. Permissible functions are not kept in this state.
+int Transduction::ResubSim(int nWords, long long nConfLimit) {
+  if(Verbose(1))
+    cout << "Resubstitution sim" << endl;
+  TRANSDUCTION_TRACE_SCOPE("ResubSim");
+  TRANSDUCTION_PERF_SCOPE("ResubSim");
+  if(nSimWords != nWords || vSimPats.size() != vPis.size() * nWords)
+    ResetPatterns(nWords);
+  state = PfState::sim;
+  int count = 0;
+  int nodes = CountNodes();
+  TransductionBackup b;
+  Save(b);
+  vector<word> vSims, vSims2, vCare;
+  Simulate(vSims);
+  vector<unsigned> vRedundants;
+  list<int> targets = vObjs;
+  for(list<int>::reverse_iterator it = targets.rbegin(); it != targets.rend(); it++) {
+    if(vvFos[*it].empty() || vFrozen[*it])
+      continue;
+    if(Verbose(2))
+      cout << "\tResubstitute sim " << *it << endl;
+    TRANSDUCTION_TRACE_SCOPE_ARG("ResubSimTarget", *it);
+    NewTravId();
+    MarkFoCone(*it);
+    SimulateCare(*it, vSims, vSims2, vCare);
+    int f = -1;
+    SimulateRedundant(*it, -1, vSims, vCare, vRedundants);
+    if(vRedundants.empty()) {
+      word const *p = &vSims[(size_t)*it * nSimWords];
+      vector<int> vCands(vPis.begin(), vPis.end());
+      for(list<int>::iterator it2 = vObjs.begin(); it2 != vObjs.end(); it2++)
+        if(!IsTravIdCurrent(*it2) && !vvFos[*it2].empty())
+          vCands.push_back(*it2);
+      for(unsigned j = 0; f == -1 && j < vCands.size(); j++)
+        for(int c = 0; c < 2; c++) {
+          int f2 = (vCands[j] << 1) ^ c;
+          if(find(vvFis[*it].begin(), vvFis[*it].end(), f2) != vvFis[*it].end() || find(vvFis[*it].begin(), vvFis[*it].end(), f2 ^ 1) != vvFis[*it].end())
+            continue;
+          word const *q = &vSims[(size_t)vCands[j] * nSimWords];
+          word m = c? ~0ull: 0;
+          int k = 0;
+          for(; k < nSimWords; k++)
+            if(vCare[k] & p[k] & ~(q[k] ^ m))
+              break;
+          if(k < nSimWords)
+            continue;
+          SimulateRedundant(*it, f2, vSims, vCare, vRedundants);
+          if(vRedundants.size() > 1) {
+            f = f2;
+            break;
+          }
+        }
+      if(f == -1)
+        continue;
+    }
+    int wires = CountWires();
+    if(f != -1) {
+      if(Verbose(3))
+        cout << "\t\tConnect " << (f >> 1) << "(" << (f & 1) << ")" << endl;
+      Connect(*it, f, true);
+    }
+    sort(vRedundants.rbegin(), vRedundants.rend());
+    for(unsigned j = 0; j < vRedundants.size(); j++) {
+      if(Verbose(3))
+        cout << "\t\tRemove wire " << (vvFis[*it][vRedundants[j]] >> 1) << "(" << (vvFis[*it][vRedundants[j]] & 1) << ")" << endl;
+      Disconnect(*it, vvFis[*it][vRedundants[j]] >> 1, vRedundants[j]);
+    }
+    if(vvFis[*it].size() == 1) {
+      Replace(*it, vvFis[*it][0]);
+      vObjs.erase(find(vObjs.begin(), vObjs.end(), *it));
+    }
+    for(list<int>::reverse_iterator it2 = vObjs.rbegin(); it2 != vObjs.rend();) {
+      if(vvFos[*it2].empty()) {
+        Remove(*it2);
+        it2 = list<int>::reverse_iterator(vObjs.erase(--(it2.base())));
+        continue;
+      }
+      it2++;
+    }
+    vector<int> vValues;
+    int r = CountNodes() < nodes? CheckChange(*it, b, vValues, nConfLimit): 1;
+    if(fLevel)
+      ComputeLevel();
+    if(r != 1 || (fLevel && CountLevels() > nMaxLevels) || CountNodes() >= nodes) {
+      if(Verbose(3))
+        cout << "\t\tRollback" << (r == 0? " (counterexample)": r == -1? " (undecided)": "") << endl;
+      Load(b);
+      if(r == 0) {
+        AddPattern(vValues);
+        Simulate(vSims);
+      }
+      continue;
+    }
+    count += wires - CountWires();
+    nodes = CountNodes();
+    Save(b);
+    Simulate(vSims);
+  }
+  Build();
+  return count;
+}
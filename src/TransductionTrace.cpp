@@ -0,0 +1,78 @@
+#include <fstream>
+#include <iomanip>
+#include <stdexcept>
+
+#include "TransductionTrace.h"
+
+using namespace std;
+
+atomic<bool> TransductionTrace::fOpen(false);
+unsigned TransductionTrace::nSampleRate = 1;
+long long TransductionTrace::nMaxEvents = 0;
+double TransductionTrace::nMinMicros = 0;
+long long TransductionTrace::nDropped = 0;
+string TransductionTrace::filename;
+chrono::steady_clock::time_point TransductionTrace::origin;
+mutex TransductionTrace::mtx;
+vector<TransductionTrace::Event> TransductionTrace::vEvents;
+map<thread::id, int> TransductionTrace::tids;
+
+void TransductionTrace::Open(string const &filename_, unsigned nSampleRate_, long long nMaxEvents_, double nMinMicros_) {
+  if(fOpen)
+    Close();
+  lock_guard<mutex> lock(mtx);
+  filename = filename_;
+  nSampleRate = max(nSampleRate_, 1u);
+  nMaxEvents = nMaxEvents_;
+  nMinMicros = nMinMicros_;
+  nDropped = 0;
+  vEvents.clear();
+  tids.clear();
+  origin = chrono::steady_clock::now();
+  fOpen = true;
+}
+
+void TransductionTrace::Record(char const *name, int arg, chrono::steady_clock::time_point start) {
+  chrono::steady_clock::time_point end = chrono::steady_clock::now();
+  double dur = chrono::duration<double, micro>(end - start).count();
+  if(dur < nMinMicros)
+    return;
+  lock_guard<mutex> lock(mtx);
+  if(!fOpen)
+    return;
+  if((long long)vEvents.size() >= nMaxEvents) {
+    nDropped++;
+    return;
+  }
+  map<thread::id, int>::iterator it = tids.insert(make_pair(this_thread::get_id(), (int)tids.size())).first;
+  Event e;
+  e.name = name;
+  e.arg = arg;
+  e.tid = it->second;
+  e.ts = chrono::duration<double, micro>(start - origin).count();
+  e.dur = dur;
+  vEvents.push_back(e);
+}
+
+void TransductionTrace::Close() {
+  lock_guard<mutex> lock(mtx);
+  if(!fOpen)
+    return;
+  fOpen = false;
+  ofstream f(filename);
+  if(!f)
+    throw runtime_error("cannot open " + filename);
+  f << "{\"traceEvents\":[" << endl;
+  f << fixed << setprecision(3);
+  for(unsigned i = 0; i < vEvents.size(); i++) {
+    Event const &e = vEvents[i];
+    f << "{\"name\":\"" << e.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << e.tid << ",\"ts\":" << e.ts << ",\"dur\":" << e.dur;
+    if(e.arg != -1)
+      f << ",\"args\":{\"node\":" << e.arg << "}";
+    f << "}," << endl;
+  }
+  f << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"transduction\"}}" << endl;
+  f << "],\"displayTimeUnit\":\"ms\",\"otherData\":{\"sampleRate\":" << nSampleRate << ",\"dropped\":" << nDropped << "}}" << endl;
+  vEvents.clear();
+  tids.clear();
+}
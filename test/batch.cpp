@@ -0,0 +1,325 @@
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <set>
+#include <cstring>
+#include <cstdio>
+#include <memory>
+
+#include <sys/stat.h>
+#include <dirent.h>
+
+#include "Transduction.h"
+#include "TransductionCec.h"
+
+using namespace std;
+
+struct Job {
+  string input;
+  string output;
+  string checkpoint;
+  long long nBytes;
+  long long nMem;
+  int nPis;
+  int nPos;
+  int nGates;
+  int nGatesOpt;
+  double seconds;
+  string status;
+  string trace;
+};
+
+struct Options {
+  string outdir = ".";
+  string report;
+  int nThreads = thread::hardware_concurrency();
+  long long nMemLimit = 0;
+  int nVerbose = 0;
+  int nSortType = 0;
+  int nPiShuffle = 0;
+  bool fLevel = false;
+  bool fFirstMerge = false;
+  bool fMspfMerge = false;
+  bool fMspfResub = false;
+  bool fInner = false;
+  bool fOuter = false;
+  string flow;
+  string ckptdir;
+  double nCecSeconds = 0;
+  string trace;
+  int nTraceRate = 1;
+  bool fPerf = false;
+};
+
+// Rough peak memory of a job from the size of its AIGER file, dominated by
+// the BDD manager which starts with 2^20 nodes.
+static long long EstimateMemory(long long nBytes) {
+  return (1ll << 26) + nBytes * 4096;
+}
+
+static string BaseName(string const &path) {
+  size_t p = path.find_last_of('/');
+  return p == string::npos? path: path.substr(p + 1);
+}
+
+// Output name of each input, with a numeric suffix on inputs whose base
+// names would collide, as in a.aig, a.1.aig, a.2.aig.
+static void AssignOutputs(vector<Job> &jobs, string const &outdir) {
+  set<string> names;
+  for(unsigned i = 0; i < jobs.size(); i++) {
+    string name = BaseName(jobs[i].input);
+    string stem = name.substr(0, name.size() - 4);
+    for(int k = 1; !names.insert(name).second; k++)
+      name = stem + "." + to_string(k) + ".aig";
+    jobs[i].output = outdir + "/" + name;
+  }
+}
+
+static bool IsDirectory(string const &path) {
+  struct stat st;
+  return !stat(path.c_str(), &st) && S_ISDIR(st.st_mode);
+}
+
+static void AddInput(string const &path, vector<Job> &jobs) {
+  if(IsDirectory(path)) {
+    DIR *d = opendir(path.c_str());
+    if(!d)
+      return;
+    vector<string> names;
+    while(dirent *e = readdir(d)) {
+      string name = e->d_name;
+      if(name.size() > 4 && name.compare(name.size() - 4, 4, ".aig") == 0)
+        names.push_back(name);
+    }
+    closedir(d);
+    sort(names.begin(), names.end());
+    for(unsigned i = 0; i < names.size(); i++)
+      AddInput(path + "/" + names[i], jobs);
+    return;
+  }
+  if(path.size() <= 4 || path.compare(path.size() - 4, 4, ".aig") != 0) {
+    ifstream f(path);
+    string line;
+    while(getline(f, line))
+      if(!line.empty())
+        AddInput(line, jobs);
+    return;
+  }
+  Job job = Job();
+  job.input = path;
+  struct stat st;
+  job.nBytes = stat(path.c_str(), &st)? 0: st.st_size;
+  job.nMem = EstimateMemory(job.nBytes);
+  job.nGates = job.nGatesOpt = -1;
+  jobs.push_back(job);
+}
+
+static void Run(Job &job, Options const &opt) {
+  auto start = chrono::steady_clock::now();
+  try {
+    aigman aig(job.input);
+    job.nPis = aig.nPis;
+    job.nPos = aig.nPos;
+    job.nGates = aig.nGates;
+    aigman aigOrig = aig;
+    unique_ptr<Transduction> t;
+    if(!job.checkpoint.empty() && ifstream(job.checkpoint))
+      t.reset(new Transduction(job.checkpoint, 0));
+    else
+      t.reset(new Transduction(aig, 0, opt.nSortType, opt.nPiShuffle, opt.fLevel));
+    if(!job.checkpoint.empty())
+      t->SetCheckpoint(job.checkpoint);
+    if(opt.flow.empty())
+      t->Optimize(opt.fFirstMerge, opt.fMspfMerge, opt.fMspfResub, opt.fInner, opt.fOuter);
+    else {
+      t->RunFlow(opt.flow);
+      job.trace = t->FlowTrace();
+    }
+    t->GenerateAig(aig);
+    job.nGatesOpt = aig.nGates;
+    job.status = "ok";
+    if(opt.nCecSeconds > 0) {
+      TransductionCec cec(aigOrig, aig);
+      int r = cec.Check(opt.nCecSeconds);
+      if(r == 0)
+        job.status = "not-equivalent";
+      else if(r == -1)
+        job.status = "unverified";
+    }
+    if(job.status != "not-equivalent") {
+      aig.write(job.output);
+      if(!job.checkpoint.empty())
+        remove(job.checkpoint.c_str());
+    }
+  } catch(exception const &e) {
+    job.status = string("error: ") + e.what();
+  }
+  job.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+// Jobs are started largest first. A job is admitted only while the
+// estimated memory of the running jobs stays within the limit, except
+// that one job may always run.
+static void RunAll(vector<Job> &jobs, Options const &opt) {
+  vector<int> order(jobs.size());
+  for(unsigned i = 0; i < jobs.size(); i++)
+    order[i] = i;
+  stable_sort(order.begin(), order.end(), [&](int a, int b) { return jobs[a].nBytes > jobs[b].nBytes; });
+  mutex mtx;
+  condition_variable cv;
+  unsigned next = 0;
+  int nRunning = 0;
+  long long nMemUsed = 0;
+  auto worker = [&]() {
+    unique_lock<mutex> lock(mtx);
+    while(true) {
+      if(next == order.size())
+        return;
+      Job &job = jobs[order[next]];
+      if(nRunning && opt.nMemLimit && nMemUsed + job.nMem > opt.nMemLimit) {
+        cv.wait(lock);
+        continue;
+      }
+      next++;
+      nRunning++;
+      nMemUsed += job.nMem;
+      lock.unlock();
+      Run(job, opt);
+      lock.lock();
+      nRunning--;
+      nMemUsed -= job.nMem;
+      if(opt.nVerbose) {
+        cout << BaseName(job.output) << ": " << job.status;
+        if(!job.trace.empty())
+          cout << " (flow " << job.trace << ")";
+        cout << endl;
+      }
+      cv.notify_all();
+    }
+  };
+  vector<thread> threads;
+  for(int i = 0; i < max(opt.nThreads, 1); i++)
+    threads.emplace_back(worker);
+  for(unsigned i = 0; i < threads.size(); i++)
+    threads[i].join();
+}
+
+static void WriteReport(vector<Job> const &jobs, ostream &os) {
+  os << left << setw(32) << "design" << right << setw(8) << "pis" << setw(8) << "pos" << setw(10) << "gates" << setw(10) << "opt" << setw(9) << "red%" << setw(12) << "time(s)" << "  status" << endl;
+  long long nGates = 0, nGatesOpt = 0;
+  double seconds = 0;
+  int nFailed = 0;
+  for(unsigned i = 0; i < jobs.size(); i++) {
+    Job const &job = jobs[i];
+    os << left << setw(32) << BaseName(job.output) << right;
+    if(job.nGatesOpt >= 0) {
+      double red = job.nGates? 100.0 * (job.nGates - job.nGatesOpt) / job.nGates: 0;
+      os << setw(8) << job.nPis << setw(8) << job.nPos << setw(10) << job.nGates << setw(10) << job.nGatesOpt << setw(9) << fixed << setprecision(2) << red;
+      nGates += job.nGates;
+      nGatesOpt += job.nGatesOpt;
+    } else
+      os << setw(8) << "-" << setw(8) << "-" << setw(10) << "-" << setw(10) << "-" << setw(9) << "-";
+    os << setw(12) << fixed << setprecision(3) << job.seconds << "  " << job.status << endl;
+    seconds += job.seconds;
+    nFailed += job.status != "ok";
+  }
+  os << "total: " << jobs.size() << " designs, " << nFailed << " not ok, gates " << nGates << " -> " << nGatesOpt << ", time " << fixed << setprecision(3) << seconds << "s" << endl;
+}
+
+static void Usage(char const *name) {
+  cout << "usage: " << name << " [options] <input>..." << endl;
+  cout << "  inputs are aig files, directories of aig files, or files listing inputs" << endl;
+  cout << "  -o <dir>   output directory [.]" << endl;
+  cout << "  -r <file>  report file [<dir>/report.txt]" << endl;
+  cout << "  -j <n>     number of threads [hardware concurrency]" << endl;
+  cout << "  -m <MB>    memory limit for admitting jobs, 0 for none [0]" << endl;
+  cout << "  -s <n>     sort type [0]" << endl;
+  cout << "  -p <n>     pi shuffle seed [0]" << endl;
+  cout << "  -l         preserve levels" << endl;
+  cout << "  -f         first merge" << endl;
+  cout << "  -g         use mspf for merge" << endl;
+  cout << "  -x         use mspf for resubstitution" << endl;
+  cout << "  -i         inner loop" << endl;
+  cout << "  -u         outer loop" << endl;
+  cout << "  -w <flow>  run a flow such as \"({mrMR})\" instead of the options above" << endl;
+  cout << "  -c <sec>   verify each result with a time budget, 0 for none [0]" << endl;
+  cout << "  -q <dir>   checkpoint each job in dir and resume from checkpoints left there" << endl;
+  cout << "  -e <file>  write a Chrome trace of the runs" << endl;
+  cout << "  -y <n>     keep every n-th trace event of each kind [1]" << endl;
+  cout << "  -k         report hardware counters per phase in the report" << endl;
+  cout << "  -v <n>     verbosity [0]" << endl;
+}
+
+int main(int argc, char **argv) {
+  Options opt;
+  vector<Job> jobs;
+  for(int i = 1; i < argc; i++) {
+    string arg = argv[i];
+    if(arg.size() != 2 || arg[0] != '-') {
+      AddInput(arg, jobs);
+      continue;
+    }
+    char c = arg[1];
+    if(strchr("orjmspcvweyq", c) && i + 1 == argc) {
+      Usage(argv[0]);
+      return 1;
+    }
+    switch(c) {
+    case 'o': opt.outdir = argv[++i]; break;
+    case 'r': opt.report = argv[++i]; break;
+    case 'j': opt.nThreads = atoi(argv[++i]); break;
+    case 'm': opt.nMemLimit = atoll(argv[++i]) << 20; break;
+    case 's': opt.nSortType = atoi(argv[++i]); break;
+    case 'p': opt.nPiShuffle = atoi(argv[++i]); break;
+    case 'c': opt.nCecSeconds = atof(argv[++i]); break;
+    case 'v': opt.nVerbose = atoi(argv[++i]); break;
+    case 'w': opt.flow = argv[++i]; break;
+    case 'q': opt.ckptdir = argv[++i]; break;
+    case 'e': opt.trace = argv[++i]; break;
+    case 'y': opt.nTraceRate = atoi(argv[++i]); break;
+    case 'l': opt.fLevel = true; break;
+    case 'f': opt.fFirstMerge = true; break;
+    case 'g': opt.fMspfMerge = true; break;
+    case 'x': opt.fMspfResub = true; break;
+    case 'i': opt.fInner = true; break;
+    case 'u': opt.fOuter = true; break;
+    case 'k': opt.fPerf = true; break;
+    default:
+      Usage(argv[0]);
+      return 1;
+    }
+  }
+  if(jobs.empty()) {
+    Usage(argv[0]);
+    return 1;
+  }
+  mkdir(opt.outdir.c_str(), 0755);
+  if(!opt.ckptdir.empty())
+    mkdir(opt.ckptdir.c_str(), 0755);
+  AssignOutputs(jobs, opt.outdir);
+  if(!opt.ckptdir.empty())
+    for(unsigned i = 0; i < jobs.size(); i++)
+      jobs[i].checkpoint = opt.ckptdir + "/" + BaseName(jobs[i].output) + ".ckpt";
+  if(!opt.trace.empty())
+    TransductionTrace::Open(opt.trace, opt.nTraceRate);
+  if(opt.fPerf && !TransductionPerf::Enable())
+    cout << "hardware counters are unavailable, profiling is off" << endl;
+  RunAll(jobs, opt);
+  if(!opt.trace.empty())
+    TransductionTrace::Close();
+  if(opt.report.empty())
+    opt.report = opt.outdir + "/report.txt";
+  ofstream f(opt.report);
+  WriteReport(jobs, f);
+  WriteReport(jobs, cout);
+  if(opt.fPerf) {
+    TransductionPerf::Report(f);
+    TransductionPerf::Report(cout);
+  }
+  return 0;
+}
@@ -3,8 +3,12 @@
 #include <random>
 #include <ctime>
 #include <cassert>
+#include <memory>
+#include <cstdio>
+#include <unistd.h>
 
 #include "Transduction.h"
+#include "TransductionCec.h"
 
 using namespace std;
 
@@ -17,16 +21,27 @@ void Print(Transduction const & t, chrono::steady_clock::time_point const & star
 
 int main(int argc, char ** argv) {
   bool fMspf = true;
-  bool fLevel = true;
   int N = 100;
-  int M = 6;
+  int M = 10;
   srand(time(NULL));
+  bool fLevel = rand() % 2;
   int nSortType = rand() % 4;
   int nPiShuffle = rand();
+  int nMspfWindow = rand() % 4;
+  bool fPrioritize = rand() % 2;
+  int nResubThreads = rand() % 3;
+  TransductionConfig config;
+  config.nSortType = nSortType;
+  config.nPiShuffle = nPiShuffle;
+  config.fLevel = fLevel;
+  config.nVarOrder = rand() % 3;
+  bool fEco = rand() % 2;
+  int nEcoFlips = rand() % 3 + 1;
+  unsigned nEcoSeed = rand();
   vector<int> Tests;
   for(int i = 0; i < N; i++)
     Tests.push_back(rand() % M);
-  cout << "nSortType = " << nSortType << "; nPiShuffle = " << nPiShuffle << ";" << endl;
+  cout << "nSortType = " << nSortType << "; nPiShuffle = " << nPiShuffle << "; nMspfWindow = " << nMspfWindow << "; fPrioritize = " << fPrioritize << "; nResubThreads = " << nResubThreads << "; nVarOrder = " << config.nVarOrder << "; fLevel = " << fLevel << "; fEco = " << fEco << ";" << endl;
   cout << "Tests = {";
   string delim;
   for(unsigned i = 0; i < Tests.size(); i++) {
@@ -35,7 +50,26 @@ int main(int argc, char ** argv) {
   }
   cout << "};" << endl;
   aigman aig(argv[1]);
-  Transduction t(aig, 0, nSortType, nPiShuffle, fLevel);
+  aigman aigOld, aigOpt;
+  if(fEco) {
+    // Optimize the input, and then modify it by flipping fanin polarities
+    // to obtain an eco to be merged with the result.
+    aigOld = aig;
+    Transduction t0(aigOld, config, 0);
+    t0.Optimize(config);
+    t0.GenerateAig(aigOpt);
+    mt19937 rng(nEcoSeed);
+    for(int k = 0; k < nEcoFlips && aig.nObjs > aig.nPis + 1; k++) {
+      int i = aig.nPis + 1 + rng() % (aig.nObjs - aig.nPis - 1);
+      aig.vObjs[i + i + rng() % 2] ^= 1;
+    }
+  }
+  aigman aigOrig = aig;
+  unique_ptr<Transduction> pt(fEco? new Transduction(aig, aigOld, aigOpt, 0, nSortType, nPiShuffle, fLevel): new Transduction(aig, config, 0));
+  Transduction &t = *pt;
+  t.SetMspfWindow(nMspfWindow);
+  t.SetSchedule(fPrioritize);
+  t.SetResubThreads(nResubThreads);
   int count = t.CountWires();
   int level = fLevel? t.CountLevels(): 0;
   auto start = chrono::steady_clock::now();
@@ -61,6 +95,8 @@ int main(int argc, char ** argv) {
       break;
     case 2:
       count -= fMspf? t.Mspf(true): t.Cspf(true);
+      if(fMspf)
+        assert(t.MspfSkipDebug());
       assert(fMspf? t.MspfDebug(): t.CspfDebug());
       break;
     case 3:
@@ -78,6 +114,37 @@ int main(int argc, char ** argv) {
       count -= fMspf? t.Mspf(true): t.Cspf(true);
       assert(fMspf? t.MspfDebug(): t.CspfDebug());
       break;
+    case 6:
+      count -= t.ResubSim();
+      break;
+    case 7:
+      count -= t.RunFlow(fMspf? "{mrMR}": "{mr}");
+      if(t.State() == PfState::cspf)
+        assert(t.CspfDebug());
+      else if(t.State() == PfState::mspf)
+        assert(t.MspfDebug());
+      break;
+    case 8: {
+      string ckpt = "tmp" + to_string(getpid()) + ".ckpt";
+      t.WriteCheckpoint(ckpt);
+      Transduction t2(ckpt, 0);
+      remove(ckpt.c_str());
+      aigman aig1, aig2;
+      t.GenerateAig(aig1);
+      t2.GenerateAig(aig2);
+      if(!t2.Verify() || t2.CountWires() != t.CountWires() || (fLevel && t2.CountLevels() != t.CountLevels()) || aig1.vObjs != aig2.vObjs || aig1.vPos != aig2.vPos) {
+        cout << "Checkpoint does not restore the network!" << endl;
+        return 1;
+      }
+      break;
+    }
+    case 9:
+      if(fLevel)
+        break;
+      count -= t.RunFlow(fMspf? "{smrSMR}": "{smr}");
+      count -= fMspf? t.Mspf(true): t.Cspf(true);
+      assert(fMspf? t.MspfDebug(): t.CspfDebug());
+      break;
     default:
       cout << "Wrong test pattern!" << endl;
       return 1;
@@ -98,5 +165,15 @@ int main(int argc, char ** argv) {
     t.GenerateAig(aig);
     aig.write("tmp.aig");
   }
+  TransductionCec cec(aigOrig, aig);
+  int r = cec.Check(60);
+  if(r == 0) {
+    cout << "Generated AIG is not equivalent!" << endl;
+    return 1;
+  }
+  if(r == -1) {
+    cout << "Equivalence of generated AIG is undecided!" << endl;
+    return 2;
+  }
   return 0;
 }
@@ -1,13 +1,69 @@
 #include <iostream>
 #include <cassert>
+#include <cstdlib>
+#include <memory>
+#include <fstream>
 
 #include "Transduction.h"
+#include "TransductionCache.h"
+#include "TransductionCec.h"
+
+// With a checkpoint file, the run resumes from it if a previous run left
+// one, and keeps it up to date.
+void Run(aigman &aig, TransductionConfig const &config, std::string const &checkpoint) {
+  std::unique_ptr<Transduction> tra;
+  if(!checkpoint.empty() && std::ifstream(checkpoint))
+    tra.reset(new Transduction(checkpoint, 0));
+  else
+    tra.reset(new Transduction(aig, config, 0));
+  if(!checkpoint.empty())
+    tra->SetCheckpoint(checkpoint);
+  tra->Optimize(config);
+  tra->GenerateAig(aig);
+}
 
 int main(int argc, char **argv) {
   aigman aig(argv[1]);
-  Transduction tra(aig, 0, 0, 0);
-  tra.Optimize(false, false, false, false, false);
-  tra.GenerateAig(aig);
+  aigman aigOrig = aig;
+  TransductionConfig config;
+  std::string cachedir;
+  std::string checkpoint;
+  double nCecSeconds = 60;
+  for(int i = 2; i < argc; i++) {
+    std::string arg = argv[i];
+    if(arg == "-c" && i + 1 < argc)
+      config.Read(argv[++i]);
+    else if(arg == "-k" && i + 1 < argc)
+      checkpoint = argv[++i];
+    else if(arg == "-t" && i + 1 < argc)
+      nCecSeconds = atof(argv[++i]);
+    else
+      cachedir = arg;
+  }
+  if(!cachedir.empty()) {
+    TransductionCache cache(cachedir);
+    std::string key = TransductionCache::Key(aig, config.nSortType, config.nPiShuffle, config.fLevel, config.fFirstMerge, config.fMspfMerge, config.fMspfResub, config.fInner, config.fOuter);
+    if(!cache.Lookup(key, aig)) {
+      Run(aig, config, checkpoint);
+      cache.Insert(key, aig);
+    }
+  } else
+    Run(aig, config, checkpoint);
+#ifdef TRANSDUCTION_COUNT_REFS
+  std::cout << "IncRef " << TransductionRefCounts::nIncRefs << ", DecRef " << TransductionRefCounts::nDecRefs << std::endl;
+#endif
+  // Exit code 1 means not equivalent, and 2 means the check ran out of
+  // time, in which case the result is written but unverified.
+  TransductionCec cec(aigOrig, aig);
+  int r = cec.Check(nCecSeconds);
+  if(r == 0) {
+    std::cout << "Circuits are not equivalent!" << std::endl;
+    return 1;
+  }
   aig.write("tmp.aig");
+  if(r == -1) {
+    std::cout << "Equivalence is undecided!" << std::endl;
+    return 2;
+  }
   return 0;
 }
@@ -0,0 +1,293 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <random>
+#include <chrono>
+#include <thread>
+#include <cstring>
+
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <dirent.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include "Transduction.h"
+
+using namespace std;
+
+struct Sample {
+  TransductionConfig config;
+  int nRuns;
+  int nFailed;
+  double seconds;
+  long long nWires;
+  long long nLevels;
+};
+
+struct Run {
+  int iSample;
+  int iDesign;
+  pid_t pid;
+  int fd;
+  chrono::steady_clock::time_point deadline;
+};
+
+struct Options {
+  string output = "tune.cfg";
+  int nJobs = thread::hardware_concurrency();
+  double nRunSeconds = 60;
+  double nBudget = 0;
+  int nSamples = 16;
+  unsigned seed = 0;
+  int nVerbose = 0;
+};
+
+static bool IsDirectory(string const &path) {
+  struct stat st;
+  return !stat(path.c_str(), &st) && S_ISDIR(st.st_mode);
+}
+
+static void AddInput(string const &path, vector<string> &designs) {
+  if(!IsDirectory(path)) {
+    designs.push_back(path);
+    return;
+  }
+  DIR *d = opendir(path.c_str());
+  if(!d)
+    return;
+  vector<string> names;
+  while(dirent *e = readdir(d)) {
+    string name = e->d_name;
+    if(name.size() > 4 && name.compare(name.size() - 4, 4, ".aig") == 0)
+      names.push_back(name);
+  }
+  closedir(d);
+  sort(names.begin(), names.end());
+  for(unsigned i = 0; i < names.size(); i++)
+    designs.push_back(path + "/" + names[i]);
+}
+
+static int CountAigLevels(aigman const &aig) {
+  vector<int> vLevels(aig.nObjs);
+  for(int i = aig.nPis + 1; i < aig.nObjs; i++)
+    vLevels[i] = max(vLevels[aig.vObjs[i + i] >> 1], vLevels[aig.vObjs[i + i + 1] >> 1]) + 1;
+  int nLevels = 0;
+  for(int i = 0; i < aig.nPos; i++)
+    nLevels = max(nLevels, vLevels[aig.vPos[i] >> 1]);
+  return nLevels;
+}
+
+// The first sample is the default configuration, so that the
+// recommendation is never worse than what tra does without one.
+static TransductionConfig RandomConfig(mt19937 &rng, bool fDefault) {
+  TransductionConfig config;
+  if(fDefault)
+    return config;
+  static int const nReos[] = {1000, 4000, 16000, 64000};
+  config.nSortType = rng() % 4;
+  config.nPiShuffle = rng() % 2? rng() % 1000 + 1: 0;
+  config.fLevel = rng() % 2;
+  config.fFirstMerge = rng() % 2;
+  config.fMspfMerge = rng() % 2;
+  config.fMspfResub = rng() % 2;
+  config.fInner = rng() % 2;
+  config.fOuter = rng() % 2;
+  config.nGbc = rng() % 2;
+  config.nReo = nReos[rng() % 4];
+  config.nVarOrder = rng() % 3;
+  return config;
+}
+
+// Each run is a child process so that a run past its deadline can be
+// killed, reporting "wires levels seconds" through a pipe.
+static bool Start(Run &run, TransductionConfig const &config, string const &design, Options const &opt) {
+  int fds[2];
+  if(pipe(fds))
+    return false;
+  pid_t pid = fork();
+  if(pid < 0) {
+    close(fds[0]);
+    close(fds[1]);
+    return false;
+  }
+  if(pid == 0) {
+    close(fds[0]);
+    int r = 1;
+    try {
+      auto start = chrono::steady_clock::now();
+      aigman aig(design);
+      Transduction t(aig, config, 0);
+      t.Optimize(config);
+      int nWires = t.CountWires();
+      t.GenerateAig(aig);
+      double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+      stringstream ss;
+      ss << nWires << " " << CountAigLevels(aig) << " " << seconds << endl;
+      string s = ss.str();
+      r = write(fds[1], s.c_str(), s.size()) != (ssize_t)s.size();
+    } catch(exception const &e) {
+      cerr << design << ": " << e.what() << endl;
+    }
+    _exit(r);
+  }
+  close(fds[1]);
+  run.pid = pid;
+  run.fd = fds[0];
+  run.deadline = chrono::steady_clock::now() + chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<double>(opt.nRunSeconds));
+  return true;
+}
+
+static bool Finish(Run const &run, int status, Sample &sample) {
+  char buf[256];
+  ssize_t n = read(run.fd, buf, sizeof(buf) - 1);
+  close(run.fd);
+  if(!WIFEXITED(status) || WEXITSTATUS(status) || n <= 0)
+    return false;
+  buf[n] = 0;
+  stringstream ss(buf);
+  long long nWires, nLevels;
+  double seconds;
+  if(!(ss >> nWires >> nLevels >> seconds))
+    return false;
+  sample.nWires += nWires;
+  sample.nLevels += nLevels;
+  sample.seconds += seconds;
+  return true;
+}
+
+// Runs are scheduled sample by sample. A run that fails or times out
+// charges the per-run limit and disqualifies its sample. No run is
+// started after the total budget is spent.
+static void RunAll(vector<Sample> &samples, vector<string> const &designs, Options const &opt) {
+  auto start = chrono::steady_clock::now();
+  vector<Run> runs;
+  unsigned next = 0, nTasks = samples.size() * designs.size();
+  while(next < nTasks || !runs.empty()) {
+    bool fBudget = opt.nBudget <= 0 || chrono::duration<double>(chrono::steady_clock::now() - start).count() < opt.nBudget;
+    while(fBudget && next < nTasks && (int)runs.size() < max(opt.nJobs, 1)) {
+      Run run;
+      run.iSample = next / designs.size();
+      run.iDesign = next % designs.size();
+      next++;
+      if(!Start(run, samples[run.iSample].config, designs[run.iDesign], opt)) {
+        samples[run.iSample].nFailed++;
+        continue;
+      }
+      runs.push_back(run);
+    }
+    if(!fBudget)
+      nTasks = next;
+    for(unsigned i = 0; i < runs.size(); i++) {
+      Run &run = runs[i];
+      Sample &sample = samples[run.iSample];
+      int status;
+      pid_t r = waitpid(run.pid, &status, WNOHANG);
+      if(r == 0 && chrono::steady_clock::now() < run.deadline)
+        continue;
+      if(r == 0) {
+        kill(run.pid, SIGKILL);
+        waitpid(run.pid, &status, 0);
+      }
+      sample.nRuns++;
+      if(r == 0 || !Finish(run, status, sample)) {
+        if(r == 0)
+          close(run.fd);
+        sample.nFailed++;
+        sample.seconds += opt.nRunSeconds;
+      }
+      if(opt.nVerbose)
+        cout << "sample " << run.iSample << " " << designs[run.iDesign] << (r == 0? ": timeout": "") << endl;
+      runs[i--] = runs.back();
+      runs.pop_back();
+    }
+    this_thread::sleep_for(chrono::milliseconds(10));
+  }
+}
+
+static bool Complete(Sample const &sample, unsigned nDesigns) {
+  return sample.nRuns == (int)nDesigns && !sample.nFailed;
+}
+
+static bool Dominates(Sample const &a, Sample const &b) {
+  if(a.seconds > b.seconds || a.nWires > b.nWires || a.nLevels > b.nLevels)
+    return false;
+  return a.seconds < b.seconds || a.nWires < b.nWires || a.nLevels < b.nLevels;
+}
+
+static void Print(Sample const &sample, int i, ostream &os) {
+  TransductionConfig const &c = sample.config;
+  os << setw(6) << i << setw(12) << fixed << setprecision(3) << sample.seconds << setw(10) << sample.nWires << setw(8) << sample.nLevels << "  ";
+  os << "sort " << c.nSortType << " shuffle " << c.nPiShuffle << " flags " << c.fLevel << c.fFirstMerge << c.fMspfMerge << c.fMspfResub << c.fInner << c.fOuter << " gbc " << c.nGbc << " reo " << c.nReo << " order " << c.nVarOrder << endl;
+}
+
+static void Usage(char const *name) {
+  cout << "usage: " << name << " [options] <input>..." << endl;
+  cout << "  inputs are aig files or directories of aig files" << endl;
+  cout << "  -o <file>  recommended configuration [tune.cfg]" << endl;
+  cout << "  -j <n>     number of parallel runs [hardware concurrency]" << endl;
+  cout << "  -t <sec>   time limit of a run [60]" << endl;
+  cout << "  -b <sec>   total time budget, 0 for none [0]" << endl;
+  cout << "  -n <n>     number of sampled configurations [16]" << endl;
+  cout << "  -s <n>     random seed [0]" << endl;
+  cout << "  -v <n>     verbosity [0]" << endl;
+}
+
+int main(int argc, char **argv) {
+  Options opt;
+  vector<string> designs;
+  for(int i = 1; i < argc; i++) {
+    string arg = argv[i];
+    if(arg.size() != 2 || arg[0] != '-') {
+      AddInput(arg, designs);
+      continue;
+    }
+    char c = arg[1];
+    if(!strchr("ojtbnsv", c) || i + 1 == argc) {
+      Usage(argv[0]);
+      return 1;
+    }
+    switch(c) {
+    case 'o': opt.output = argv[++i]; break;
+    case 'j': opt.nJobs = atoi(argv[++i]); break;
+    case 't': opt.nRunSeconds = atof(argv[++i]); break;
+    case 'b': opt.nBudget = atof(argv[++i]); break;
+    case 'n': opt.nSamples = atoi(argv[++i]); break;
+    case 's': opt.seed = atoi(argv[++i]); break;
+    case 'v': opt.nVerbose = atoi(argv[++i]); break;
+    }
+  }
+  if(designs.empty() || opt.nSamples < 1) {
+    Usage(argv[0]);
+    return 1;
+  }
+  mt19937 rng(opt.seed);
+  vector<Sample> samples(opt.nSamples, Sample());
+  for(unsigned i = 0; i < samples.size(); i++)
+    samples[i].config = RandomConfig(rng, i == 0);
+  RunAll(samples, designs, opt);
+  cout << setw(6) << "sample" << setw(12) << "time(s)" << setw(10) << "wires" << setw(8) << "levels" << "  configuration" << endl;
+  int best = -1;
+  for(unsigned i = 0; i < samples.size(); i++) {
+    if(!Complete(samples[i], designs.size()))
+      continue;
+    bool fDominated = false;
+    for(unsigned j = 0; j < samples.size() && !fDominated; j++)
+      fDominated = Complete(samples[j], designs.size()) && Dominates(samples[j], samples[i]);
+    if(fDominated)
+      continue;
+    Print(samples[i], i, cout);
+    if(best == -1 || make_tuple(samples[i].nWires, samples[i].nLevels, samples[i].seconds) < make_tuple(samples[best].nWires, samples[best].nLevels, samples[best].seconds))
+      best = i;
+  }
+  if(best == -1) {
+    cout << "no configuration completed on all designs" << endl;
+    return 1;
+  }
+  ofstream f(opt.output);
+  samples[best].config.Write(f);
+  cout << "recommended: sample " << best << ", written to " << opt.output << endl;
+  return 0;
+}